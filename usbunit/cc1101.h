@@ -11,8 +11,27 @@
 
 /**
  * Frequency channels
+ *
+ * Each channel is a profile of carrier frequency and modulation,
+ * see cc1101_profile[]. Channel 0 is the default.
  */
-#define NUMBER_OF_FCHANNELS      10
+#define NUMBER_OF_FCHANNELS      5
+#define CC1101_PROFILE_REGS      9           // CC1101_FREQ2 - CC1101_DEVIATN
+
+/* Channel scanning
+ *
+ * The receiver stays CC1101_DWELL_msec on a channel, longer as long as
+ * frames are received. After a sensor was decoded it stays on that
+ * channel for CC1101_STICKY_s. Channels without frames for
+ * CC1101_QUIET_VISITS visits are visited in every 4th round only.
+ */
+#define CC1101_DWELL_msec        250
+#define CC1101_STICKY_s          120
+#define CC1101_QUIET_VISITS       16
+#define CC1101_QUIET_ROUNDS        4
+#define CC1101_RECAL_s           600         // Repeat synthesizer calibration
+#define CC1101_DEFAULT_CHANNELS  0x01        // Bit mask, channel 0 only
+#define CC1101_MCSM0_MANUAL_CAL  0x08        // CC1101_DEFVAL_MCSM0 without FS_AUTOCAL
 
 /**
  * Type of transfers
@@ -85,7 +104,7 @@
 #define CC1101_MDMCFG2           0x12        // Modem Configuration
 #define CC1101_MDMCFG1           0x13        // Modem Configuration
 #define CC1101_MDMCFG0           0x14        // Modem Configuration
-#define CC1101_DEVIATN           0x45        // Modem Deviation Setting //jayrock: was 0x15
+#define CC1101_DEVIATN           0x15        // Modem Deviation Setting
 #define CC1101_MCSM2             0x16        // Main Radio Control State Machine Configuration
 #define CC1101_MCSM1             0x17        // Main Radio Control State Machine Configuration
 #define CC1101_MCSM0             0x18        // Main Radio Control State Machine Configuration
@@ -138,8 +157,13 @@
 // #define CC1101_DEFVAL_IOCFG0     0x0D        // GDO0 Output Pin Configuration
 #define CC1101_DEFVAL_IOCFG0     0x0E        // GDO0 Output Pin Configuration - Carrier Sense output
 #define CC1101_DEFVAL_FIFOTHR    0x0F        // RX FIFO and TX FIFO Thresholds - 64 bytes in FIFO
-#define CC1101_DEFVAL_SYNC1      0xD5        // Synchronization word, high byte  11010101 01001111
-#define CC1101_DEFVAL_SYNC0      0x4F        // Synchronization word, low byte
+/* The register writes before the burst configuration never set SYNC1, and
+ * the DEVIATN write went to address 0x45, a burst write to SYNC0.
+ * SYNC1, SYNC0 and DEVIATN keep the values the receiver always ran with.
+ * The sync word is not used in asynchronous serial mode.
+ */
+#define CC1101_DEFVAL_SYNC1      0xD3        // Synchronization word, high byte (chip reset value)
+#define CC1101_DEFVAL_SYNC0      0x41        // Synchronization word, low byte
 #define CC1101_DEFVAL_PKTLEN     0x09        // Packet Length
 #define CC1101_DEFVAL_PKTCTRL1   0x00        // Packet Automation Control
 #define CC1101_DEFVAL_PKTCTRL0   0x30        // Packet Automation Control
@@ -162,7 +186,7 @@
 
 #define CC1101_DEFVAL_MDMCFG1    0x22        // Modem Configuration Channel spacing 200kHz
 #define CC1101_DEFVAL_MDMCFG0    0xF8        // Modem Configuration
-#define CC1101_DEFVAL_DEVIATN    0x41        // Modem Deviation Setting (+/-28.56kHz)
+#define CC1101_DEFVAL_DEVIATN    0x47        // Modem Deviation Setting (+/-47.6kHz, chip reset value)
 #define CC1101_DEFVAL_MCSM2      0x07        // Main Radio Control State Machine Configuration
 // #define CC1101_DEFVAL_MCSM1      0x30        // Main Radio Control State Machine Configuration
 #define CC1101_DEFVAL_MCSM1      0x3C        // Main Radio Control State Machine Configuration
@@ -199,6 +223,138 @@
 #define CC1101_DEFVAL_TEST0      0x09        // Various Test Settings
 
 
+/*
+ * Receive buffer
+ *
+ * Every edge is stored as a 2 bit pulse code, 4 edges per byte.
+ * The first edge goes to the lowest bits.
+ */
+#define PULSE_BITS               2
+#define PULSE_MASK               0x03
+#define PULSES_PER_BYTE          4
+
+/* Max number of edges per frame */
+#define CC1101_MAX_TIMINGS       255
+#define CC1101_PULSE_BYTES       ((CC1101_MAX_TIMINGS + PULSES_PER_BYTE - 1) / PULSES_PER_BYTE)
+
+/* Number of frames that can be queued for decoding */
+#define CC1101_RX_FRAMES         2
+
+/* Pulse width histogram for clock recovery.
+ * PULSE_HIST_BINS bins of (1 << PULSE_HIST_SHIFT) usec.
+ * The last bin collects all longer pulses and is not used for recovery.
+ */
+#define PULSE_HIST_BINS          32
+#define PULSE_HIST_SHIFT         3
+/* All bins are halved when the total exceeds this (rolling histogram) */
+#define PULSE_HIST_MAX_COUNT     4096
+/* Min number of pulses per cluster before the threshold is adapted */
+#define PULSE_HIST_MIN_COUNT     200
+
+/* Limits of the adaptive SHORT/LONG threshold */
+#define PULSE_LONG_MIN_usec      40
+#define PULSE_LONG_MAX_usec      160
+
+/* Pulses closer than this to the SHORT/LONG threshold are remembered as weak.
+ * They are the first candidates for error correction.
+ */
+#define CC1101_WEAK_PULSES       4
+#define CC1101_WEAK_PULSE_usec   15
+
+/* Max wait for CHIP_RDYn, the crystal needs about 150 usec after reset */
+#define CC1101_MISO_TIMEOUT_usec  2000
+
+/* Adaptive carrier sense
+ *
+ * Every CC1101_CS_WINDOW_s the carrier detects that did not lead to a
+ * preamble are counted as false wakeups. Too many raise the carrier sense
+ * level, very few lower it. If no preamble was found for CC1101_CS_SILENT_s
+ * the level steps back towards the default, we may be missing sensors.
+ */
+#define CC1101_CS_WINDOW_s        10
+#define CC1101_CS_FALSE_HIGH      50     // false wakeups per second
+#define CC1101_CS_FALSE_LOW        5
+#define CC1101_CS_SILENT_s       300
+#define CC1101_CS_LEVELS           8
+#define CC1101_CS_DEFAULT_LEVEL    2     // CC1101_DEFVAL_AGCCTRL2/1
+
+/* Packet mode (CC1101_PACKET_SUPPORT)
+ *
+ * The CC1101 searches the preamble as sync word and stores the fixed
+ * length packet followed by RSSI and LQI in its RX FIFO.
+ * GDO2 is asserted on sync word and deasserted at the end of the packet,
+ * the falling edge tells the AVR to read the packet.
+ *
+ * The CC1101 Manchester decoder also applies to the sync word, so the
+ * preamble 0xAAA9 (line bits) can only be matched with it switched off.
+ * The packet holds the line bits, 2 bytes per data byte, which the AVR
+ * decodes with manchester_table[].
+ */
+#define CC1101_PACKET_SYNC        0xAAA9      // Preamble of abarth124 and renault
+#define CC1101_PACKET_LEN         18          // 9 Manchester encoded data bytes
+#define CC1101_PACKET_STATUS      2           // appended RSSI, LQI
+#define CC1101_PACKET_IOCFG2      0x06        // sync word received until end of packet
+#define CC1101_PACKET_PKTCTRL1    0x04        // APPEND_STATUS
+#define CC1101_PACKET_PKTCTRL0    0x00        // RX FIFO, no CRC, fixed length
+#define CC1101_PACKET_MDMCFG2     0x02        // 16/16 sync word bits, or'ed with the profile
+
+#if defined(CC1101_PACKET_SUPPORT) && defined(CC1101_ICP_SUPPORT)
+#error "CC1101_PACKET_SUPPORT needs GDO2 on INT0 (D2)"
+#endif
+
+/* Signal strength
+ *
+ * In edge mode the edge ISR reads the RSSI register once per frame at
+ * edge CC1101_RSSI_EDGE, inside the preamble. It skips the sample if
+ * loop() is using the SPI bus at that moment. In packet mode the CC1101
+ * appends RSSI and LQI to the packet.
+ */
+#define CC1101_RSSI_EDGE          16
+#define CC1101_RSSI_NONE          0x80        // -138 dBm, no sample
+#define CC1101_RSSI_OFFSET        74          // dBm at 433 MHz
+
+/* RSSI status byte to dBm */
+static inline int cc1101_rssi_dbm( byte raw)
+{
+  return (int8_t)raw / 2 - CC1101_RSSI_OFFSET;
+}
+
+/* Edge timestamps
+ *
+ * With CC1101_ICP_SUPPORT Timer1 latches the edge time in hardware.
+ * Timer1 runs at clk/8, 0.5 usec per tick at 16 MHz, and wraps after 32 msec.
+ * Without it the edge interrupt reads micros() (4 usec resolution).
+ */
+#ifdef CC1101_ICP_SUPPORT
+typedef uint16_t edge_time_t;
+#if F_CPU == 16000000L
+#define EDGE_TICK_SHIFT          1           // usec = ticks >> 1
+#else
+#define EDGE_TICK_SHIFT          0           // 8 MHz, 1 usec per tick
+#endif
+#else
+typedef unsigned long edge_time_t;
+#define EDGE_TICK_SHIFT          0
+#endif
+
+typedef struct rxFrame_t {
+  byte pulses[CC1101_PULSE_BYTES];
+  byte count;
+  bool first_edge_state;
+  byte weak_count;
+  byte weak_idx[CC1101_WEAK_PULSES];   // Index of weak pulse
+  byte weak_dist[CC1101_WEAK_PULSES];  // Distance to SHORT/LONG threshold
+  byte channel;                        // Channel the frame was received on
+  byte rssi;                           // RSSI status byte sampled in the preamble
+} rxFrame_t;
+
+/* Channel profile, registers CC1101_FREQ2 - CC1101_DEVIATN */
+typedef struct cc1101Profile_t {
+  char name[12];
+  byte regs[CC1101_PROFILE_REGS];
+} cc1101Profile_t;
+
+
 /**
  * Class: CCPACKET
  * 
@@ -229,11 +385,27 @@ class CC1101 {
     unsigned int freqOffset;
     unsigned int demodLinkQuality;
     unsigned int rssiValue;
+    byte csLevel;                 // Carrier sense level, see cc1101_cs_level[]
+    bool csAdaptive;
+    bool packetMode;              // CC1101 packet handler instead of edge decoding
 
   public:
     void reset();
     void getStatusInfo();
     bool getCarrierStatus();
+    void setChannels( uint16_t mask);
+    uint16_t getChannels();
+    void scanChannels();
+    void channelHit( byte channel);
+    void sendChannelStatistics();
+    void setCarrierSense( byte level);
+    void adaptCarrierSense();
+    void getCarrierSense( byte *agcctrl2, byte *agcctrl1);
+#ifdef CC1101_PACKET_SUPPORT
+    void setPacketMode( bool on);
+    bool readPacket( byte packet[], byte *rssi, byte *lqi);
+    byte getChannel();
+#endif
 
     void setIdleState();
     void setRxState();
@@ -245,8 +417,31 @@ class CC1101 {
     void deselect();
     void writeReg(byte regAddr, byte value);
     byte readReg(byte regAddr, byte regType);
+    void writeBurst_P(byte regAddr, const byte *values, byte len);
+    void readBurst(byte regAddr, byte *values, byte len);
+    void writeBurst(byte regAddr, const byte *values, byte len);
+    void wait_Miso();
     void wakeUp();
     void configureRegisters();
+
+    void setChannel( byte channel);
+
+    uint16_t channel_mask;
+    uint16_t channel_cal_valid;
+    byte channel_cal[NUMBER_OF_FCHANNELS][3];       // FSCAL3 - FSCAL1
+    byte channel_quiet[NUMBER_OF_FCHANNELS];        // visits without frames
+    unsigned int channel_hits[NUMBER_OF_FCHANNELS];
+    unsigned int channel_frames_seen;               // frames at dwell start
+    unsigned long channel_dwell_start;
+    unsigned long channel_cal_time;
+    unsigned long channel_last_hit;
+    byte channel_sticky;
+    byte channel_round;
+
+    unsigned long cs_window_start;
+    unsigned long cs_last_good;
+    unsigned long cs_detected;
+    unsigned int cs_good;
 };
 
 #endif
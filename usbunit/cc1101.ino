@@ -31,11 +31,20 @@ SPIClass spi;
  *     |                      \      |
  *     |                        \    V
  *   DATA <------ CDintr ------< RECEIVING >--+
- * AVAILABLE   (carrier lost)        ^        |
- *                                   |     EdgeIntr
+ * AVAILABLE   (carrier lost,        ^        |
+ *             queue full)           |     EdgeIntr
  *                                   |        |
  *                                   +--------+
  * 
+ * A frame with a valid carrier length is queued in rx_frame[].
+ * The receiver goes back to IDLE and captures the next frame
+ * as long as there is a free slot. It stays in DATA_AVAILABLE
+ * only if all slots are in use until loop() releases a frame.
+ * 
+ * Edges are stored as 2 bit pulse codes (SHORT_PULSE / LONG_PULSE),
+ * 4 edges per byte, first edge in the lowest bits.
+ * The level of every edge follows from first_edge_state as levels
+ * alternate with each edge.
  */
 #define STATE_IDLE               0
 #define STATE_CARRIER_DETECTED   1
@@ -44,33 +53,295 @@ SPIClass spi;
 
 static volatile byte receiver_state;
 
-static volatile bool first_edge_state = LOW;
+volatile rxFrame_t rx_frame[CC1101_RX_FRAMES];
+volatile byte rx_write = 0;   // Frame currently captured by the ISR
+volatile byte rx_read = 0;    // Next frame to be decoded by loop()
+volatile byte rx_ready = 0;   // Number of frames queued for decoding
+
+volatile byte rx_channel = 0;                                 // Active channel
+volatile unsigned int channel_frames[NUMBER_OF_FCHANNELS];    // Frames queued per channel
 
-#define CC1101_MAX_TIMINGS   255
-volatile byte timings[CC1101_MAX_TIMINGS];
-volatile byte timings_count = 0;
+volatile static edge_time_t last_edge_time = 0;
+static volatile bool spi_busy = false;     // loop() is in an SPI transfer
 
-volatile static unsigned long last_edge_time_usec = 0;
+#ifdef CC1101_ICP_SUPPORT
+/* Timer1 count, the capture ISR toggles ICES1 before the edge is processed.
+ * So the level after the captured edge is the inverse of ICES1.
+ */
+#define edge_time_now()     TCNT1
+#define edge_level()        ((TCCR1B & _BV(ICES1)) ? LOW : HIGH)
+#define edge_irq_on()       { TIFR1 = _BV(ICF1); TIMSK1 |= _BV(ICIE1); }
+#define edge_irq_off()      TIMSK1 &= ~_BV(ICIE1)
+#define edge_irq_pending()  (TIFR1 & _BV(ICF1))
+#define edge_irq_clear()    TIFR1 = _BV(ICF1)
+#else
+#define edge_time_now()     micros()
+#define edge_level()        digitalRead(CC1101_RXPin)
+/* CC1101_RXPin D2 is INT0 */
+#define edge_irq_on()       { EIFR = _BV(INTF0); EIMSK |= _BV(INT0); }
+#define edge_irq_off()      EIMSK &= ~_BV(INT0)
+#define edge_irq_pending()  (EIFR & _BV(INTF0))
+#define edge_irq_clear()    EIFR = _BV(INTF0)
+#endif
 
-#define MIN_BIT_LEN_usec    MIN_SHORT_usec
+/* The edge interrupt is enabled only while a carrier is received.
+ * Noise on GDO2 while idle does not cost any CPU time.
+ */
+static bool edge_gate = false;
+
+/* Active pulse thresholds.
+ * Pulses shorter than pulse_min_short_usec are receive errors.
+ * Pulses shorter than pulse_min_long_usec are SHORT_PULSE, others LONG_PULSE.
+ * pulse_min_long_usec follows the pulse width histogram if pulse_adaptive is set.
+ */
+volatile byte pulse_min_short_usec = MIN_SHORT_usec;
+volatile byte pulse_min_long_usec = MIN_LONG_usec;
+bool pulse_adaptive = true;
+
+volatile unsigned int pulse_hist[PULSE_HIST_BINS];
+volatile unsigned int pulse_hist_total = 0;
 
 /* Range of valid carrier length */
 #define CARRIER_MIN_LEN_usec    9500
 #define CARRIER_MAX_LEN_usec   10500
 unsigned long carrier_len_usec;
 
+/* Enable edge interrupts, called from ISR on carrier detect */
+static void edge_gate_open()
+{
+  edge_irq_on();
+  edge_gate = true;
+}
+
+/* Disable edge interrupts.
+ * Must be called with interrupts disabled.
+ */
+static void edge_gate_close()
+{
+  edge_irq_off();
+  edge_gate = false;
+}
+
+/* Count edge interrupts avoided by the closed gate, called from loop().
+ * Edges still set the interrupt flag while the interrupt is masked.
+ * At most one edge is counted per call, so this is a lower bound.
+ * Not used in packet mode, GDO2 is the packet interrupt there.
+ */
+void count_masked_edges()
+{
+  cli();
+  if( !edge_gate && edge_irq_pending()) {
+    edge_irq_clear();
+    statistics.edges_avoided++;
+  }
+  sei();
+}
+
+/* Restart capturing of the current frame */
 void init_receiver()
 {
-  timings_count = 0;
+  edge_gate_close();
+  rx_frame[rx_write].count = 0;
+  rx_frame[rx_write].weak_count = 0;
   receiver_state = STATE_IDLE;
 }
 
+/* Remember a pulse that was close to the SHORT/LONG boundary.
+ * If the list is full replace the entry farthest from the boundary.
+ * Called from ISR.
+ */
+static void add_weak_pulse( volatile rxFrame_t *frame, byte idx, byte dist)
+{
+  byte w;
+  byte worst = 0;
+
+  if( frame->weak_count < CC1101_WEAK_PULSES) {
+    w = frame->weak_count++;
+  } else {
+    for( w = 1; w < CC1101_WEAK_PULSES; w++) {
+      if( frame->weak_dist[w] > frame->weak_dist[worst]) {
+        worst = w;
+      }
+    }
+    if( dist >= frame->weak_dist[worst]) {
+      return;
+    }
+    w = worst;
+  }
+
+  frame->weak_idx[w] = idx;
+  frame->weak_dist[w] = dist;
+}
+
+/* Returns the oldest queued frame or NULL if there is none.
+ * The frame is owned by loop() until release_frame() is called.
+ */
+rxFrame_t *next_frame()
+{
+  if( rx_ready == 0) {
+    return NULL;
+  }
+
+  return (rxFrame_t*)&rx_frame[rx_read];
+}
+
+/* Hand the frame returned by next_frame() back to the receiver. */
+void release_frame()
+{
+  cli();
+  rx_read = (rx_read + 1) % CC1101_RX_FRAMES;
+  rx_ready--;
+
+  if( receiver_state == STATE_DATA_AVAILABLE) {
+    /* Queue was full, continue receiving */
+    init_receiver();
+  }
+  sei();
+}
+
+/* Clock recovery.
+ *
+ * The histogram holds two clusters: SHORT pulses (one half bit) and
+ * LONG pulses (two half bits). Starting at the current threshold the
+ * mean of both clusters is computed and the threshold is moved to
+ * the middle between them. This is repeated a few times.
+ *
+ * Called from loop().
+ */
+void adapt_pulse_thresholds()
+{
+  unsigned int hist[PULSE_HIST_BINS];
+  unsigned long sum_short, sum_long;
+  unsigned int n_short, n_long;
+  unsigned int split;
+  unsigned int center;
+  byte b, i;
+
+  cli();
+  for( b = 0; b < PULSE_HIST_BINS; b++) {
+    if( pulse_hist_total > PULSE_HIST_MAX_COUNT) {
+      pulse_hist[b] >>= 1;
+    }
+    hist[b] = pulse_hist[b];
+  }
+  if( pulse_hist_total > PULSE_HIST_MAX_COUNT) {
+    pulse_hist_total >>= 1;
+  }
+  sei();
+
+  if( !pulse_adaptive) {
+    return;
+  }
+
+  split = pulse_min_long_usec;
+
+  for( i = 0; i < 3; i++) {
+    sum_short = sum_long = 0;
+    n_short = n_long = 0;
+
+    for( b = 0; b < PULSE_HIST_BINS - 1; b++) {
+      center = (b << PULSE_HIST_SHIFT) + (1 << (PULSE_HIST_SHIFT - 1));
+
+      if( center < split) {
+        sum_short += (unsigned long)center * hist[b];
+        n_short += hist[b];
+      } else {
+        sum_long += (unsigned long)center * hist[b];
+        n_long += hist[b];
+      }
+    }
+
+    if( n_short < PULSE_HIST_MIN_COUNT || n_long < PULSE_HIST_MIN_COUNT) {
+      /* Not enough data yet */
+      return;
+    }
+
+    split = (sum_short / n_short + sum_long / n_long) / 2;
+  }
+
+  if( split < PULSE_LONG_MIN_usec) {
+    split = PULSE_LONG_MIN_usec;
+  } else if( split > PULSE_LONG_MAX_usec) {
+    split = PULSE_LONG_MAX_usec;
+  }
+
+  pulse_min_long_usec = split;
+}
+
+/* Send pulse thresholds and histogram.
+ * Called by the I command.
+ */
+void dump_pulse_statistics()
+{
+  unsigned long elapsed;
+  byte b;
+
+  Serial.print(F("+pulse short = "));
+  Serial.println(pulse_min_short_usec);
+  Serial.print(F("+pulse long  = "));
+  Serial.print(pulse_min_long_usec);
+  Serial.println(pulse_adaptive ? F(" auto") : F(" fixed"));
+
+  Serial.print(F("+rx reset us = "));
+  Serial.println(cc1101_reset_usec);
+  Serial.print(F("+rx cfg us   = "));
+  Serial.println(cc1101_config_usec);
+  Serial.print(F("+miso tmout  = "));
+  Serial.println(cc1101_miso_timeouts);
+
+  /* Edge interrupts are masked while idle. The avoided ISR calls
+   * are a lower bound, see count_masked_edges().
+   */
+  elapsed = millis() - statistics_start;
+  if( elapsed > 0) {
+    Serial.print(F("+intr/s      = "));
+    Serial.println((statistics.cs_interrupts + statistics.data_interrupts) * 1000.0 / elapsed, 0);
+    Serial.print(F("+edge skip/s = "));
+    Serial.println(statistics.edges_avoided * 1000.0 / elapsed, 0);
+  }
+
+  /* 8 bins per line, first value is the lower bound in usec */
+  for( b = 0; b < PULSE_HIST_BINS; b++) {
+    if( (b & 7) == 0) {
+      Serial.print(F("+hist "));
+      Serial.print(b << PULSE_HIST_SHIFT);
+      Serial.print(F(" ="));
+    }
+    Serial.print(F(" "));
+    Serial.print(pulse_hist[b]);
+    if( (b & 7) == 7) {
+      Serial.println();
+    }
+  }
+}
+
 /* **********************************  interrupt handler   ******************************* */
 
-void edge_interrupt()
+/* Read the RSSI status register from the edge ISR.
+ * The CC1101 is in RX, so it is ready and there is no need to wait for MISO.
+ * This takes about 10 usec, less than the shortest pulse.
+ */
+static byte read_rssi()
 {
-  unsigned long ts = micros();
-  unsigned long bit_len_usec;
+  byte val;
+
+  spi.beginTransaction(SPISettings(5000000,MSBFIRST,SPI_MODE0));
+  digitalWrite(CC1101_CS, LOW);
+  spi.transfer(CC1101_RSSI | CC1101_STATUS_REGISTER);
+  val = spi.transfer(0x00);
+  digitalWrite(CC1101_CS, HIGH);
+  spi.endTransaction();
+
+  return val;
+}
+
+/* Process one edge at time 'ts' */
+static inline void receive_edge( edge_time_t ts)
+{
+  edge_time_t bit_len_usec;
+  volatile rxFrame_t *frame;
+  byte pulse;
+  byte idx;
 
   statistics.data_interrupts++;
   
@@ -82,24 +353,28 @@ void edge_interrupt()
 
     case STATE_CARRIER_DETECTED:
     
-      first_edge_state = digitalRead(CC1101_RXPin);
+      rx_frame[rx_write].first_edge_state = edge_level();
+      rx_frame[rx_write].rssi = CC1101_RSSI_NONE;
       receiver_state = STATE_RECEIVING;
       /* Fall throught */
 
     case STATE_RECEIVING:
 
-      if (timings_count >= CC1101_MAX_TIMINGS)
+      frame = &rx_frame[rx_write];
+      idx = frame->count;
+
+      if (idx >= CC1101_MAX_TIMINGS)
       {//buffer full - don't accpet anymore
         break;
       }
 
-      bit_len_usec = ts - last_edge_time_usec;
-      last_edge_time_usec = ts;
+      bit_len_usec = (edge_time_t)(ts - last_edge_time) >> EDGE_TICK_SHIFT;
+      last_edge_time = ts;
 
-      if (bit_len_usec < MIN_BIT_LEN_usec)
+      if (bit_len_usec < pulse_min_short_usec)
       { /* This is a receive error => restart */
 
-        if( timings_count >= 16)
+        if( idx >= 16)
         { /* Skip preamble, we want to count data errors only */
           statistics.bit_errors++;
         }
@@ -107,13 +382,41 @@ void edge_interrupt()
         init_receiver();
         break;
       }
-  
-      if (bit_len_usec > 255)
-      {
-        bit_len_usec = 255;
+
+      if( pulse_hist_total < 0xffff) {
+        pulse_hist_total++;
+        if( bit_len_usec >= (PULSE_HIST_BINS << PULSE_HIST_SHIFT)) {
+          pulse_hist[PULSE_HIST_BINS - 1]++;
+        } else {
+          pulse_hist[bit_len_usec >> PULSE_HIST_SHIFT]++;
+        }
       }
 
-      timings[timings_count++] = (byte)bit_len_usec;
+      if( bit_len_usec < pulse_min_long_usec) {
+        pulse = SHORT_PULSE;
+        if( bit_len_usec + CC1101_WEAK_PULSE_usec > pulse_min_long_usec) {
+          add_weak_pulse( frame, idx, pulse_min_long_usec - bit_len_usec);
+        }
+      } else {
+        pulse = LONG_PULSE;
+        if( bit_len_usec < pulse_min_long_usec + CC1101_WEAK_PULSE_usec) {
+          add_weak_pulse( frame, idx, bit_len_usec - pulse_min_long_usec);
+        }
+      }
+
+      /* The first pulse of a byte overwrites old content,
+       * so there is no need to clear the buffer.
+       */
+      if( (idx & (PULSES_PER_BYTE - 1)) == 0) {
+        frame->pulses[idx / PULSES_PER_BYTE] = pulse;
+      } else {
+        frame->pulses[idx / PULSES_PER_BYTE] |= pulse << ((idx & (PULSES_PER_BYTE - 1)) * PULSE_BITS);
+      }
+      frame->count = idx + 1;
+
+      if( idx == CC1101_RSSI_EDGE && !spi_busy) {
+        frame->rssi = read_rssi();
+      }
       
       break;
 
@@ -123,6 +426,31 @@ void edge_interrupt()
   }
 }
 
+#ifdef CC1101_ICP_SUPPORT
+
+/* Timer1 input capture on ICP1.
+ * Only one edge direction is captured, switch to the other one first
+ * so that the next edge is not lost while this one is processed.
+ */
+ISR( TIMER1_CAPT_vect)
+{
+  edge_time_t ts = ICR1;
+
+  TCCR1B ^= _BV(ICES1);
+  TIFR1 = _BV(ICF1);    /* Changing ICES1 may set ICF1 */
+
+  receive_edge( ts);
+}
+
+#else
+
+void edge_interrupt()
+{
+  receive_edge( micros());
+}
+
+#endif
+
 void carrier_sense_interrupt()
 {
   unsigned long ts = micros();
@@ -134,7 +462,18 @@ void carrier_sense_interrupt()
   {
     case STATE_IDLE:
       if( carrier == HIGH) {
-        carrier_len_usec = last_edge_time_usec = ts;
+        carrier_len_usec = ts;
+        last_edge_time = edge_time_now();
+        edge_gate_open();
+#ifdef CC1101_ICP_SUPPORT
+        /* Resync edge direction, the first edge is the opposite of the current level */
+        if( PINB & _BV(PINB0)) {
+          TCCR1B &= ~_BV(ICES1);
+        } else {
+          TCCR1B |= _BV(ICES1);
+        }
+        TIFR1 = _BV(ICF1);
+#endif
         receiver_state = STATE_CARRIER_DETECTED;
         statistics.carrier_detected++;
       }
@@ -159,8 +498,21 @@ void carrier_sense_interrupt()
         }
         
         if ((carrier_len_usec >= CARRIER_MIN_LEN_usec) && (carrier_len_usec <= CARRIER_MAX_LEN_usec)) {
-          receiver_state = STATE_DATA_AVAILABLE;
           statistics.data_available++; 
+
+          rx_frame[rx_write].channel = rx_channel;
+          channel_frames[rx_channel]++;
+
+          /* Queue frame and move on to the next slot */
+          rx_write = (rx_write + 1) % CC1101_RX_FRAMES;
+          rx_ready++;
+
+          if( rx_ready >= CC1101_RX_FRAMES) {
+            edge_gate_close();
+            receiver_state = STATE_DATA_AVAILABLE;
+          } else {
+            init_receiver();
+          }
         } else {
           init_receiver();
         }
@@ -177,9 +529,87 @@ ISR( PCINT0_vect) {
   carrier_sense_interrupt();
 }
 
+#ifdef CC1101_PACKET_SUPPORT
+
+static volatile bool packet_ready = false;
+
+/* GDO2 falls at the end of a packet in packet mode */
+void packet_interrupt()
+{
+  packet_ready = true;
+}
+
+#endif
+
 /* *************************  end of interrupt handler   *************************** */
 
-#define wait_Miso()              delay(3)
+/* Carrier sense levels, from most to least sensitive.
+ *
+ * AGCCTRL1 [3:0] CARRIER_SENSE_ABS_THR relative to MAGN_TARGET,
+ *          [5:4] CARRIER_SENSE_REL_THR stays at +6 dB.
+ * AGCCTRL2 [5:3] MAX_LNA_GAIN is reduced on the top levels
+ *          after the absolute threshold reached +6 dB.
+ */
+const byte cc1101_cs_level[CC1101_CS_LEVELS][2] PROGMEM = {
+  /* AGCCTRL2 AGCCTRL1 */
+  {  0xC6,    0x5E },     // -2 dB
+  {  0xC6,    0x5F },     // -1 dB
+  {  0xC6,    0x50 },     //  0 dB, default
+  {  0xC6,    0x52 },     // +2 dB
+  {  0xC6,    0x54 },     // +4 dB
+  {  0xC6,    0x56 },     // +6 dB
+  {  0xCE,    0x56 },     // +6 dB, LNA -2.6 dB
+  {  0xD6,    0x56 }      // +6 dB, LNA -6.1 dB
+};
+
+/* Register values 0x00 (IOCFG2) - 0x2E (TEST0), written in one burst */
+const byte cc1101_config[] PROGMEM = {
+  CC1101_DEFVAL_IOCFG2,   CC1101_DEFVAL_IOCFG1,   CC1101_DEFVAL_IOCFG0,   CC1101_DEFVAL_FIFOTHR,
+  CC1101_DEFVAL_SYNC1,    CC1101_DEFVAL_SYNC0,    CC1101_DEFVAL_PKTLEN,   CC1101_DEFVAL_PKTCTRL1,
+  CC1101_DEFVAL_PKTCTRL0, CC1101_DEFVAL_ADDR,     CC1101_DEFVAL_CHANNR,   CC1101_DEFVAL_FSCTRL1,
+  CC1101_DEFVAL_FSCTRL0,  CC1101_DEFVAL_FREQ2_433, CC1101_DEFVAL_FREQ1_433, CC1101_DEFVAL_FREQ0_433,
+  CC1101_DEFVAL_MDMCFG4,  CC1101_DEFVAL_MDMCFG3,  CC1101_DEFVAL_MDMCFG2,  CC1101_DEFVAL_MDMCFG1,
+  CC1101_DEFVAL_MDMCFG0,  CC1101_DEFVAL_DEVIATN,  CC1101_DEFVAL_MCSM2,    CC1101_DEFVAL_MCSM1,
+  CC1101_DEFVAL_MCSM0,    CC1101_DEFVAL_FOCCFG,   CC1101_DEFVAL_BSCFG,    CC1101_DEFVAL_AGCCTRL2,
+  CC1101_DEFVAL_AGCCTRL1, CC1101_DEFVAL_AGCCTRL0, CC1101_DEFVAL_WOREVT1,  CC1101_DEFVAL_WOREVT0,
+  CC1101_DEFVAL_WORCTRL,  CC1101_DEFVAL_FREND1,   CC1101_DEFVAL_FREND0,   CC1101_DEFVAL_FSCAL3,
+  CC1101_DEFVAL_FSCAL2,   CC1101_DEFVAL_FSCAL1,   CC1101_DEFVAL_FSCAL0,   CC1101_DEFVAL_RCCTRL1,
+  CC1101_DEFVAL_RCCTRL0,  CC1101_DEFVAL_FSTEST,   CC1101_DEFVAL_PTEST,    CC1101_DEFVAL_AGCTEST,
+  CC1101_DEFVAL_TEST2,    CC1101_DEFVAL_TEST1,    CC1101_DEFVAL_TEST0
+};
+
+#ifdef CC1101_PACKET_SUPPORT
+/* Registers CC1101_SYNC1 - CC1101_PKTCTRL0 in packet mode */
+const byte cc1101_packet_config[] PROGMEM = {
+  CC1101_PACKET_SYNC >> 8, CC1101_PACKET_SYNC & 0xff, CC1101_PACKET_LEN,
+  CC1101_PACKET_PKTCTRL1,  CC1101_PACKET_PKTCTRL0
+};
+#endif
+
+/* Channel profiles
+ *
+ *             FREQ2 FREQ1 FREQ0 MDMCFG4 MDMCFG3 MDMCFG2 MDMCFG1 MDMCFG0 DEVIATN
+ * MDMCFG2 0x10 = GFSK, 0x30 = ASK/OOK
+ *
+ * The OOK profiles keep the FSK AGC settings, AGCCTRL2/AGCCTRL1 from
+ * cc1101_cs_level[] and CC1101_DEFVAL_AGCCTRL0. The OOK values from
+ * SmartRF Studio (AGCCTRL2 0x03, AGCCTRL1 0x00, AGCCTRL0 0x91) would
+ * replace the carrier sense thresholds that the adaptive carrier sense
+ * and the edge gate rely on. Not tested with OOK sensors.
+ */
+const cc1101Profile_t cc1101_profile[NUMBER_OF_FCHANNELS] PROGMEM = {
+  { "433.88 FSK", { 0x10, 0xB0, 0x0C, 0x59, 0x93, 0x10, 0x22, 0xF8, 0x47 }},
+  { "433.92 FSK", { 0x10, 0xB0, 0x71, 0x59, 0x93, 0x10, 0x22, 0xF8, 0x47 }},
+  { "433.92 OOK", { 0x10, 0xB0, 0x71, 0x59, 0x93, 0x30, 0x22, 0xF8, 0x47 }},
+  { "315.00 FSK", { 0x0C, 0x1D, 0x8A, 0x59, 0x93, 0x10, 0x22, 0xF8, 0x47 }},
+  { "315.00 OOK", { 0x0C, 0x1D, 0x8A, 0x59, 0x93, 0x30, 0x22, 0xF8, 0x47 }}
+};
+
+/* Driver timing, reported by usbget -i */
+unsigned long cc1101_reset_usec = 0;     // reset() until receiving
+unsigned long cc1101_config_usec = 0;    // last runtime reconfiguration
+unsigned int cc1101_miso_timeouts = 0;
+
 #define readStatusReg(regAddr)   readReg(regAddr, CC1101_STATUS_REGISTER)
 #define readConfigReg(regAddr)   readReg(regAddr, CC1101_CONFIG_REGISTER)
 
@@ -209,11 +639,418 @@ void CC1101::setTxState()
   cmdStrobe(CC1101_STX);
 }
 
+/*
+ * Select the channels to scan, bit n = channel n.
+ *
+ * A single channel is calibrated automatically on every SRX.
+ * When scanning, each channel is calibrated once and the result
+ * (FSCAL3 - FSCAL1) is written back on every switch.
+ */
+void CC1101::setChannels( uint16_t mask)
+{
+  byte first = 0;
+
+  mask &= (1 << NUMBER_OF_FCHANNELS) - 1;
+  if( mask == 0) {
+    mask = CC1101_DEFAULT_CHANNELS;
+  }
+
+  while( !(mask & (1 << first))) {
+    first++;
+  }
+
+  channel_mask = mask;
+  channel_cal_valid = 0;
+  channel_cal_time = millis();
+  channel_sticky = NUMBER_OF_FCHANNELS;
+  memset( (void*)channel_quiet, 0, sizeof(channel_quiet));
+
+  setIdleState();
+  writeReg(CC1101_MCSM0, (mask & (mask - 1)) ? CC1101_MCSM0_MANUAL_CAL : CC1101_DEFVAL_MCSM0);
+  setChannel( first);
+}
+
+uint16_t CC1101::getChannels()
+{
+  return channel_mask;
+}
+
+/*
+ * Switch to another channel.
+ */
+void CC1101::setChannel( byte channel)
+{
+  unsigned long start = micros();
+  uint16_t bit = 1 << channel;
+
+  setIdleState();
+  writeBurst_P(CC1101_FREQ2, cc1101_profile[channel].regs, CC1101_PROFILE_REGS);
+
+#ifdef CC1101_PACKET_SUPPORT
+  if( packetMode) {
+    /* The profile overwrote the sync mode, a partial packet is useless */
+    writeReg(CC1101_MDMCFG2,
+             pgm_read_byte(&cc1101_profile[channel].regs[CC1101_MDMCFG2 - CC1101_FREQ2]) | CC1101_PACKET_MDMCFG2);
+    cmdStrobe(CC1101_SFRX);
+    packet_ready = false;
+  }
+#endif
+
+  if( channel_mask & (channel_mask - 1)) {
+    if( channel_cal_valid & bit) {
+      writeBurst(CC1101_FSCAL3, channel_cal[channel], 3);
+    } else {
+      /* Calibrate once, this takes about 800 usec */
+      cmdStrobe(CC1101_SCAL);
+      while( (readStatusReg(CC1101_MARCSTATE) & 0x1f) != 0x01) {
+        if( micros() - start > CC1101_MISO_TIMEOUT_usec) break;
+      }
+      readBurst(CC1101_FSCAL3, channel_cal[channel], 3);
+      channel_cal_valid |= bit;
+    }
+  }
+
+  rx_channel = channel;
+  setRxState();
+
+  cli();
+  channel_frames_seen = channel_frames[channel];
+  sei();
+  channel_dwell_start = millis();
+
+  cc1101_config_usec = micros() - start;
+}
+
+/*
+ * Channel scheduler, called from loop().
+ */
+void CC1101::scanChannels()
+{
+  unsigned long now = millis();
+  unsigned int frames;
+  byte channel = rx_channel;
+  byte next = channel;
+  byte i;
+
+  if( (channel_mask & (channel_mask - 1)) == 0) {
+    /* Single channel */
+    return;
+  }
+
+  if( now - channel_dwell_start < CC1101_DWELL_msec || receiver_state != STATE_IDLE) {
+    /* Keep dwelling, never interrupt a frame */
+    return;
+  }
+
+#ifdef CC1101_PACKET_SUPPORT
+  /* receiver_state stays idle in packet mode, ask the CC1101:
+   * sync word found (PKTSTATUS SFD) or bytes in the RX FIFO.
+   * Carrier sense alone is not checked, noise would block hopping.
+   */
+  if(    packetMode
+      && (   packet_ready
+          || (readStatusReg(CC1101_PKTSTATUS) & 0x08)
+          || (readStatusReg(CC1101_RXBYTES) & 0x7f))) {
+    return;
+  }
+#endif
+
+  cli();
+  frames = channel_frames[channel];
+  sei();
+
+  if( frames != channel_frames_seen) {
+    /* Traffic on this channel, stay */
+    channel_quiet[channel] = 0;
+    channel_frames_seen = frames;
+    channel_dwell_start = now;
+    return;
+  }
+
+  if( channel_quiet[channel] < 255) {
+    channel_quiet[channel]++;
+  }
+
+  if( now - channel_cal_time > 1000UL * CC1101_RECAL_s) {
+    /* Temperature drift, calibrate again */
+    channel_cal_valid = 0;
+    channel_cal_time = now;
+  }
+
+  if( channel_sticky < NUMBER_OF_FCHANNELS && now - channel_last_hit < 1000UL * CC1101_STICKY_s) {
+    /* Stay where our sensors were heard last */
+    next = channel_sticky;
+  } else {
+    channel_sticky = NUMBER_OF_FCHANNELS;
+
+    for( i = 1; i <= NUMBER_OF_FCHANNELS; i++) {
+      if( channel + i == NUMBER_OF_FCHANNELS) {
+        channel_round++;
+      }
+      next = (channel + i) % NUMBER_OF_FCHANNELS;
+
+      if(    (channel_mask & (1 << next))
+          && (channel_quiet[next] < CC1101_QUIET_VISITS || (channel_round % CC1101_QUIET_ROUNDS) == 0)) {
+        break;
+      }
+    }
+  }
+
+  if( next != channel) {
+    setChannel( next);
+  } else {
+    channel_dwell_start = now;
+  }
+}
+
+/*
+ * A sensor was decoded on 'channel'.
+ */
+void CC1101::channelHit( byte channel)
+{
+  if( channel >= NUMBER_OF_FCHANNELS) {
+    return;
+  }
+
+  channel_hits[channel]++;
+  channel_quiet[channel] = 0;
+  channel_last_hit = millis();
+  channel_sticky = channel;
+}
+
+/*
+ * Send channel list with frames and decoded sensors per channel.
+ *
+ * CH0 433.88 FSK F=12 H=3 *
+ */
+void CC1101::sendChannelStatistics()
+{
+  cc1101Profile_t profile;
+  unsigned int frames;
+
+  for( byte ch = 0; ch < NUMBER_OF_FCHANNELS; ch++) {
+    if( !(channel_mask & (1 << ch))) {
+      continue;
+    }
+
+    memcpy_P( &profile, &cc1101_profile[ch], sizeof(profile));
+    cli();
+    frames = channel_frames[ch];
+    sei();
+
+    sendMoreDataStart();
+    Serial.print(F("CH"));
+    Serial.print(ch);
+    Serial.print(F(" "));
+    Serial.print(profile.name);
+    Serial.print(F(" F="));
+    Serial.print(frames);
+    Serial.print(F(" H="));
+    Serial.print(channel_hits[ch]);
+    if( ch == rx_channel) {
+      Serial.print(F(" *"));
+    }
+    sendMoreDataEnd();
+  }
+}
+
+/*
+ * Set carrier sense threshold and AGC gain limit.
+ */
+void CC1101::setCarrierSense( byte level)
+{
+  if( level >= CC1101_CS_LEVELS) {
+    level = CC1101_CS_LEVELS - 1;
+  }
+
+  unsigned long start = micros();
+
+  setIdleState();
+  /* AGCCTRL2 and AGCCTRL1 are adjacent */
+  writeBurst_P(CC1101_AGCCTRL2, cc1101_cs_level[level], 2);
+  setRxState();
+
+  csLevel = level;
+  cc1101_config_usec = micros() - start;
+}
+
+/*
+ * Read the active carrier sense registers.
+ */
+void CC1101::getCarrierSense( byte *agcctrl2, byte *agcctrl1)
+{
+  byte agcctrl[2];
+
+  readBurst(CC1101_AGCCTRL2, agcctrl, 2);
+  *agcctrl2 = agcctrl[0];
+  *agcctrl1 = agcctrl[1];
+}
+
+/*
+ * Adjust the carrier sense level to the rate of false wakeups.
+ * Called from loop().
+ */
+void CC1101::adaptCarrierSense()
+{
+  unsigned long now = millis();
+  unsigned long detected;
+  unsigned long false_wakeups;
+  unsigned int good;
+  byte level = csLevel;
+
+  if( packetMode || now - cs_window_start < 1000UL * CC1101_CS_WINDOW_s) {
+    /* There are no carrier interrupts in packet mode */
+    return;
+  }
+  cs_window_start = now;
+
+  cli();
+  detected = statistics.carrier_detected;
+  sei();
+  good = statistics.preamble_found;
+
+  if( detected < cs_detected || good < cs_good) {
+    /* Statistics have been cleared, start over */
+    cs_detected = detected;
+    cs_good = good;
+    return;
+  }
+
+  false_wakeups = detected - cs_detected;
+  if( good != cs_good) {
+    cs_last_good = now;
+    false_wakeups = (false_wakeups > good - cs_good) ? false_wakeups - (good - cs_good) : 0;
+  }
+  cs_detected = detected;
+  cs_good = good;
+
+  if( !csAdaptive) {
+    return;
+  }
+
+  if( now - cs_last_good > 1000UL * CC1101_CS_SILENT_s && level > CC1101_CS_DEFAULT_LEVEL) {
+    /* Nothing received for a long time, be more sensitive */
+    cs_last_good = now;
+    level--;
+  } else if( false_wakeups > CC1101_CS_FALSE_HIGH * CC1101_CS_WINDOW_s) {
+    if( level < CC1101_CS_LEVELS - 1) level++;
+  } else if( false_wakeups < CC1101_CS_FALSE_LOW * CC1101_CS_WINDOW_s) {
+    if( level > 0) level--;
+  }
+
+  if( level != csLevel) {
+    setCarrierSense( level);
+  }
+}
+
+#ifdef CC1101_PACKET_SUPPORT
+/*
+ * Switch between edge decoding and the CC1101 packet handler.
+ *
+ * In packet mode the CC1101 matches the preamble and fills its RX FIFO,
+ * GDO2 interrupts once per packet. The carrier sense and edge interrupts
+ * are not used.
+ */
+void CC1101::setPacketMode( bool on)
+{
+  byte mdmcfg2 = pgm_read_byte(&cc1101_profile[rx_channel].regs[CC1101_MDMCFG2 - CC1101_FREQ2]);
+
+  detachInterrupt( digitalPinToInterrupt(CC1101_RXPin));
+
+  cli();
+  PCMSK0 &= ~_BV(PCINT1);
+  init_receiver();
+  sei();
+
+  setIdleState();
+
+  if( on) {
+    writeReg(CC1101_IOCFG2, CC1101_PACKET_IOCFG2);
+    writeBurst_P(CC1101_SYNC1, cc1101_packet_config, sizeof(cc1101_packet_config));
+    writeReg(CC1101_MDMCFG2, mdmcfg2 | CC1101_PACKET_MDMCFG2);
+    cmdStrobe(CC1101_SFRX);
+
+    packet_ready = false;
+    attachInterrupt( digitalPinToInterrupt(CC1101_RXPin), packet_interrupt, FALLING);
+  } else {
+    writeReg(CC1101_IOCFG2, CC1101_DEFVAL_IOCFG2);
+    writeBurst_P(CC1101_SYNC1, &cc1101_config[CC1101_SYNC1], sizeof(cc1101_packet_config));
+    writeReg(CC1101_MDMCFG2, mdmcfg2);
+
+    attachInterrupt( digitalPinToInterrupt(CC1101_RXPin), edge_interrupt, CHANGE);
+    cli();
+    edge_irq_off();
+    PCMSK0 |= _BV(PCINT1);
+    sei();
+  }
+
+  packetMode = on;
+  setRxState();
+}
+
+/*
+ * Read the next packet from the RX FIFO, called from loop().
+ * Returns false if there is no complete packet.
+ * 'rssi' and 'lqi' are the raw status bytes appended by the CC1101.
+ */
+bool CC1101::readPacket( byte packet[], byte *rssi, byte *lqi)
+{
+  byte rxbytes, last;
+  byte status[CC1101_PACKET_STATUS];
+
+  if( !packetMode || !packet_ready) {
+    return false;
+  }
+  packet_ready = false;
+
+  /* RXBYTES may be wrong while the FIFO is written, read until it is stable */
+  rxbytes = readStatusReg(CC1101_RXBYTES);
+  do {
+    last = rxbytes;
+    rxbytes = readStatusReg(CC1101_RXBYTES);
+  } while( rxbytes != last);
+
+  if( (rxbytes & 0x80) || rxbytes < CC1101_PACKET_LEN + CC1101_PACKET_STATUS) {
+    /* RX FIFO overflow or partial packet, drop the FIFO contents.
+     * A partial packet would shift all following packets.
+     */
+    setIdleState();
+    cmdStrobe(CC1101_SFRX);
+    setRxState();
+    return false;
+  }
+
+  readBurst(CC1101_RXFIFO, packet, CC1101_PACKET_LEN);
+  readBurst(CC1101_RXFIFO, status, CC1101_PACKET_STATUS);
+  *rssi = status[0];
+  *lqi = status[1];
+
+  if( rxbytes >= 2 * (CC1101_PACKET_LEN + CC1101_PACKET_STATUS)) {
+    /* More packets queued */
+    packet_ready = true;
+  }
+
+  cli();
+  statistics.data_available++;
+  channel_frames[rx_channel]++;
+  sei();
+
+  return true;
+}
+
+byte CC1101::getChannel()
+{
+  return rx_channel;
+}
+#endif
+
 /* 
  * Reset CC1101
  */
 void CC1101::reset() 
 {
+  unsigned long start = micros();
+
   pinMode(CC1101_CS, OUTPUT);
   digitalWrite(CC1101_CS, HIGH);
 
@@ -228,9 +1065,8 @@ void CC1101::reset()
   delayMicroseconds(10);
   deselect();
   delayMicroseconds(41);
-  select();
+  select();   /* waits for CHIP_RDYn */
 
-  wait_Miso();
   spi.transfer(CC1101_SRES);
   wait_Miso();
 
@@ -238,14 +1074,41 @@ void CC1101::reset()
 
   configureRegisters();
 
-  delay(2000);
+  csLevel = CC1101_CS_DEFAULT_LEVEL;
+  csAdaptive = true;
+  packetMode = false;
+  cs_window_start = cs_last_good = millis();
+  cs_detected = 0;
+  cs_good = 0;
+
+  /* The register defaults select channel 0 */
+  channel_mask = CC1101_DEFAULT_CHANNELS;
+  channel_cal_valid = 0;
+  channel_cal_time = millis();
+  channel_sticky = NUMBER_OF_FCHANNELS;
+  channel_round = 0;
+  rx_channel = 0;
+  memset( (void*)channel_frames, 0, sizeof(channel_frames));
+  memset( (void*)channel_hits, 0, sizeof(channel_hits));
+  memset( (void*)channel_quiet, 0, sizeof(channel_quiet));
 
   setIdleState();
 
+  rx_write = rx_read = rx_ready = 0;
   init_receiver();
   clear_statistics();
 
+#ifdef CC1101_ICP_SUPPORT
+  /* Timer1 normal mode, clk/8, noise canceler, interrupt on input capture */
+  cli();
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | _BV(CS11);
+  TIFR1 = _BV(ICF1);
+  sei();
+#else
   attachInterrupt( digitalPinToInterrupt(CC1101_RXPin), edge_interrupt, CHANGE);
+  edge_irq_off();
+#endif
   // attachInterrupt( digitalPinToInterrupt(CC1101_CDPin), carrier_sense_interrupt, CHANGE);
   
   cli();
@@ -253,7 +1116,10 @@ void CC1101::reset()
   PCICR |= _BV(PCIE0);
   sei();
 
+  /* FS_AUTOCAL calibrates when going to RX */
   setRxState();
+
+  cc1101_reset_usec = micros() - start;
 }
 
 /*
@@ -283,8 +1149,27 @@ void CC1101::getStatusInfo()
  */
 void CC1101::select()
 {
+  spi_busy = true;
   spi.beginTransaction(SPISettings(5000000,MSBFIRST,SPI_MODE0));
   digitalWrite(CC1101_CS, LOW);
+  wait_Miso();
+}
+
+/*
+ * Wait until the CC1101 pulls MISO low (CHIP_RDYn).
+ * This takes a few usec normally and longer only after reset
+ * or power down.
+ */
+void CC1101::wait_Miso()
+{
+  unsigned long start = micros();
+
+  while( digitalRead(MISO) == HIGH) {
+    if( micros() - start > CC1101_MISO_TIMEOUT_usec) {
+      cc1101_miso_timeouts++;
+      return;
+    }
+  }
 }
 
 /*
@@ -294,6 +1179,7 @@ void CC1101::deselect()
 {
   digitalWrite(CC1101_CS, HIGH);
   spi.endTransaction();
+  spi_busy = false;
 }
 
 /**
@@ -321,7 +1207,6 @@ void CC1101::cmdStrobe(byte cmd)
 void CC1101::writeReg(byte regAddr, byte value) 
 {
   select();
-  //wait_Miso();
   spi.transfer(regAddr);
   spi.transfer(value);
   deselect();
@@ -344,7 +1229,6 @@ byte CC1101::readReg(byte regAddr, byte regType)
 
   addr = regAddr | regType;
   select();
-  //wait_Miso();
   spi.transfer(addr);
   val = spi.transfer(0x00);
   deselect();
@@ -352,6 +1236,63 @@ byte CC1101::readReg(byte regAddr, byte regType)
   return val;
 }
 
+/**
+ * writeBurst_P
+ * 
+ * Write consecutive registers from a table in flash memory.
+ * 
+ * 'regAddr'  First register address
+ * 'values'   Values in PROGMEM
+ * 'len'      Number of registers
+ */
+void CC1101::writeBurst_P(byte regAddr, const byte *values, byte len) 
+{
+  select();
+  spi.transfer(regAddr | WRITE_BURST);
+  for( byte i = 0; i < len; i++) {
+    spi.transfer(pgm_read_byte(&values[i]));
+  }
+  deselect();
+}
+
+/**
+ * writeBurst
+ * 
+ * Write consecutive registers.
+ * 
+ * 'regAddr'  First register address
+ * 'values'   Values
+ * 'len'      Number of registers
+ */
+void CC1101::writeBurst(byte regAddr, const byte *values, byte len) 
+{
+  select();
+  spi.transfer(regAddr | WRITE_BURST);
+  for( byte i = 0; i < len; i++) {
+    spi.transfer(values[i]);
+  }
+  deselect();
+}
+
+/**
+ * readBurst
+ * 
+ * Read consecutive config registers.
+ * 
+ * 'regAddr'  First register address
+ * 'values'   Buffer for 'len' values
+ * 'len'      Number of registers
+ */
+void CC1101::readBurst(byte regAddr, byte *values, byte len) 
+{
+  select();
+  spi.transfer(regAddr | READ_BURST);
+  for( byte i = 0; i < len; i++) {
+    values[i] = spi.transfer(0x00);
+  }
+  deselect();
+}
+
 /*
  * wakeUp
  * 
@@ -359,8 +1300,7 @@ byte CC1101::readReg(byte regAddr, byte regType)
  */
 void CC1101::wakeUp(void)
 {
-  select();
-  wait_Miso();
+  select();   /* waits for CHIP_RDYn */
   deselect();
 }
 
@@ -369,67 +1309,7 @@ void CC1101::wakeUp(void)
  */
 void CC1101::configureRegisters(void) 
 {
-  writeReg(CC1101_IOCFG2,  CC1101_DEFVAL_IOCFG2);
-  writeReg(CC1101_IOCFG1,  CC1101_DEFVAL_IOCFG1);
-  writeReg(CC1101_IOCFG0,  CC1101_DEFVAL_IOCFG0);
-  writeReg(CC1101_FIFOTHR,  CC1101_DEFVAL_FIFOTHR);
-  writeReg(CC1101_PKTLEN,  CC1101_DEFVAL_PKTLEN);
-  writeReg(CC1101_PKTCTRL1,  CC1101_DEFVAL_PKTCTRL1);
-  writeReg(CC1101_PKTCTRL0,  CC1101_DEFVAL_PKTCTRL0);
-
-  // Set default synchronization word
-  //setSyncWord(syncWord);
-
-  // Set default device address
-  //setDevAddress(devAddress);
-
-  // Set default frequency channel
-  //setChannel(channel);
-  
-  writeReg(CC1101_FSCTRL1,  CC1101_DEFVAL_FSCTRL1);
-  writeReg(CC1101_FSCTRL0,  CC1101_DEFVAL_FSCTRL0);
-
-//  // Set default carrier frequency = 868 MHz
-//  writeReg(CC1101_FREQ2,  CC1101_DEFVAL_FREQ2_868);
-//  writeReg(CC1101_FREQ1,  CC1101_DEFVAL_FREQ1_868);
-//  writeReg(CC1101_FREQ0,  CC1101_DEFVAL_FREQ0_868);
-
-  // Set default carrier frequency = 433 MHz
-  writeReg(CC1101_FREQ2,  CC1101_DEFVAL_FREQ2_433);
-  writeReg(CC1101_FREQ1,  CC1101_DEFVAL_FREQ1_433);
-  writeReg(CC1101_FREQ0,  CC1101_DEFVAL_FREQ0_433);
-
-  writeReg(CC1101_MDMCFG4,  CC1101_DEFVAL_MDMCFG4);
-  writeReg(CC1101_MDMCFG3,  CC1101_DEFVAL_MDMCFG3);
-  writeReg(CC1101_MDMCFG2,  CC1101_DEFVAL_MDMCFG2);
-  writeReg(CC1101_MDMCFG1,  CC1101_DEFVAL_MDMCFG1);
-  writeReg(CC1101_MDMCFG0,  CC1101_DEFVAL_MDMCFG0);
-  writeReg(CC1101_DEVIATN,  CC1101_DEFVAL_DEVIATN);
-  writeReg(CC1101_MCSM2,  CC1101_DEFVAL_MCSM2);
-  writeReg(CC1101_MCSM1,  CC1101_DEFVAL_MCSM1);
-  writeReg(CC1101_MCSM0,  CC1101_DEFVAL_MCSM0);
-  writeReg(CC1101_FOCCFG,  CC1101_DEFVAL_FOCCFG);
-  writeReg(CC1101_BSCFG,  CC1101_DEFVAL_BSCFG);
-  writeReg(CC1101_AGCCTRL2,  CC1101_DEFVAL_AGCCTRL2);
-  writeReg(CC1101_AGCCTRL1,  CC1101_DEFVAL_AGCCTRL1);
-  writeReg(CC1101_AGCCTRL0,  CC1101_DEFVAL_AGCCTRL0);
-  writeReg(CC1101_WOREVT1,  CC1101_DEFVAL_WOREVT1);
-  writeReg(CC1101_WOREVT0,  CC1101_DEFVAL_WOREVT0);
-  writeReg(CC1101_WORCTRL,  CC1101_DEFVAL_WORCTRL);
-  writeReg(CC1101_FREND1,  CC1101_DEFVAL_FREND1);
-  writeReg(CC1101_FREND0,  CC1101_DEFVAL_FREND0);
-  writeReg(CC1101_FSCAL3,  CC1101_DEFVAL_FSCAL3);
-  writeReg(CC1101_FSCAL2,  CC1101_DEFVAL_FSCAL2);
-  writeReg(CC1101_FSCAL1,  CC1101_DEFVAL_FSCAL1);
-  writeReg(CC1101_FSCAL0,  CC1101_DEFVAL_FSCAL0);
-  writeReg(CC1101_RCCTRL1,  CC1101_DEFVAL_RCCTRL1);
-  writeReg(CC1101_RCCTRL0,  CC1101_DEFVAL_RCCTRL0);
-  writeReg(CC1101_FSTEST,  CC1101_DEFVAL_FSTEST);
-  writeReg(CC1101_PTEST,  CC1101_DEFVAL_PTEST);
-  writeReg(CC1101_AGCTEST,  CC1101_DEFVAL_AGCTEST);
-  writeReg(CC1101_TEST2,  CC1101_DEFVAL_TEST2);
-  writeReg(CC1101_TEST1,  CC1101_DEFVAL_TEST1);
-  writeReg(CC1101_TEST0,  CC1101_DEFVAL_TEST0);
+  writeBurst_P(CC1101_IOCFG2, cc1101_config, sizeof(cc1101_config));
 }
 
 #endif
@@ -69,6 +69,7 @@
  #define OIL_SUPPORT
  #define RGB_SUPPORT
  #define WS2801_SUPPORT
+ #define LED_EFFECTS_SUPPORT
 
 #endif
 
@@ -80,6 +81,7 @@
  #define OIL_SUPPORT
  #define RGB_SUPPORT
 // #define WS2801_SUPPORT
+ #define LED_EFFECTS_SUPPORT
 
 #endif
 
@@ -100,8 +102,22 @@
   /*
    * Pin assignment
    */
+ /* Timestamp edges with Timer1 input capture instead of micros().
+  * GDO2 must be connected to D8 (ICP1) instead of D2.
+  */
+// #define CC1101_ICP_SUPPORT
+
+ /* Let the CC1101 packet handler receive the frames (PM=1 on TPMS).
+  * Not together with CC1101_ICP_SUPPORT, GDO2 must be on D2.
+  */
+// #define CC1101_PACKET_SUPPORT
+
  #define CC1101_CS       D10 // Chip Select pin
+#ifdef CC1101_ICP_SUPPORT
+ #define CC1101_RXPin    D8  // GDO2 on ICP1
+#else
  #define CC1101_RXPin    D2  // GDO2
+#endif
  #define CC1101_TXPin    D9  // wlowi: GDO0 is also TX pin
  #define CC1101_CDPin    D9  // wlowi: GDO0 carrier detect pin
 
@@ -124,9 +140,18 @@
   *       See Arduino reference pages.
   */
   
+#ifdef ARDUINO_GENERIC
+ /* PWM pins D3 (Timer2), D5 and D6 (Timer0), the Timer1 pins D9 and D10
+  * are used by the CC1101. The FX fades and bars need PWM on all colors.
+  */
+ #define RGB_RED_PORT     D3
+ #define RGB_GREEN_PORT   D5
+ #define RGB_BLUE_PORT    D6
+#else
  #define RGB_RED_PORT     D4
  #define RGB_GREEN_PORT   D5
  #define RGB_BLUE_PORT    D7
+#endif
 
 #endif
 
@@ -138,6 +163,12 @@
   */
  #define WS2801_LED_COUNT 4
 
+ /* Send with the SPI peripheral, data on MOSI and clock on SCK.
+  * Not on the Arduino together with the CC1101, the strip has no chip select.
+  * Otherwise the pins below are written directly.
+  */
+// #define WS2801_HW_SPI
+
  #define WS2801_DATA_PIN  D4
  #define WS2801_CLOCK_PIN D5
  
@@ -37,7 +37,10 @@
 #define DISPLAY_SCREEN_SETUP        2 // displays pressure (large) and ID (small)
 #define DISPLAY_SCREEN_STATISTICS1  3
 #define DISPLAY_SCREEN_STATISTICS2  4
-#define DISPLAY_SCREEN_MAX          4
+#define DISPLAY_SCREEN_STATISTICS3  5
+#define DISPLAY_SCREEN_LINK         6 // link statistics of our sensors
+#define DISPLAY_SCREEN_RENDER       7 // display refresh cost
+#define DISPLAY_SCREEN_MAX          7
 
 #define DISPLAY_DEFAULT_SCREEN     DISPLAY_SCREEN_SETUP
 
@@ -45,6 +48,35 @@
 
 #define DISPLAY_DEFAULT_LAST_UPD_sec  15 // Display last update indicator if time > this
 
+/****************/
+
+/* Text last printed per field, only changed glyphs are sent again.
+ * 9 fields: 4 large + 4 small values or one per statistics row,
+ * and the "Last update" time.
+ */
+#define DISPLAY_FIELDS              9
+#define DISPLAY_FIELD_LAST_UPD      8
+#define DISPLAY_FIELD_LEN          10
+
+#define DISPLAY_DEGREE      char(128) // degrees symbol in System5x7
+#define DISPLAY_BIG_GLYPH_W        10 // columns of a big glyph, see big_glyphs[]
+
+/****************/
+
+/* I2C transmit queue, see display.ino */
+#define DISPLAY_TWI_FREQ       400000L
+#define DISPLAY_TWI_QUEUE          128 // bytes, power of 2
+#define DISPLAY_TWI_BATCH           32 // max. bytes of one I2C transaction
+#define DISPLAY_TWI_PROBE_usec    1000
+#define DISPLAY_TWI_TIMEOUT_usec 10000 // a full queue takes about 3 msec
+
+/* Queue bytes needed to draw one glyph, including cursor commands */
+#define DISPLAY_GLYPH_BYTES_1X      20
+#define DISPLAY_GLYPH_BYTES_2X      48
+
+/* A new screen is cleared in steps of half a row */
+#define DISPLAY_CLEAR_STEPS         16
+
 
 /*
  * Configuration structure stored in EEPROM.
@@ -73,8 +105,18 @@ class Display : public Action {
     byte last_screen = 255;
     byte change = 0;
     unsigned int last_disp = 0;
+    bool last_shown = false;            // "Last update" label is displayed
     unsigned long last_update = 0;      // Last display update time
     unsigned long sensor_update_ts = 0; // Last time a sensor was updated
+    char field[DISPLAY_FIELDS][DISPLAY_FIELD_LEN];  // '\0' = empty glyph
+    byte clear_step = DISPLAY_CLEAR_STEPS;
+    bool full_pending = false;          // draw the new screen with labels
+    bool fields_pending = false;        // fields left out for lack of queue space
+    bool resume = false;                // update_display() continues a step
+    byte labels_done = 0;               // label glyphs drawn on this screen
+    byte label_pos = 0;                 // label glyph counter of this step
+    bool labels_pending = false;        // labels left out for lack of queue space
+    unsigned long queue_empty_ms = 0;   // last time the I2C queue was empty
 
   public:
     size_t setup(unsigned int eepromLocation);
@@ -88,12 +130,22 @@ class Display : public Action {
   private:
     void show_title();
     void show_last_update();
-    void update_display( tpms433_sensor_t sensor[], bool full);
-    void display_setup(tpms433_sensor_t sensor[], bool full);
-    void display_temperature(tpms433_sensor_t sensor[], bool full);
-    void display_pressure(tpms433_sensor_t sensor[], bool full);
+    void clear_fields();
+    void print_field( byte f, byte x, byte y, bool big, const char *text);
+    void print_label( byte x, byte y, const __FlashStringHelper *label);
+    void print_value( byte f, byte y, unsigned long value);
+    void format_temperature( float temp_c, char *s);
+    byte big_glyph( char ch);
+    void write_big( byte x, byte y, byte g);
+    void update_display( bool full);
+    void display_setup( bool full);
+    void display_temperature( bool full);
+    void display_pressure( bool full);
     void display_statistics1( bool full);
     void display_statistics2( bool full);
+    void display_statistics3( bool full);
+    void display_link( bool full);
+    void display_render( bool full);
 
 };
 
@@ -4,8 +4,8 @@
 
 #ifdef DISPLAY_SUPPORT
 
+#include <util/twi.h>
 #include "SSD1306Ascii.h"
-#include "SSD1306AsciiWire.h"
 
 /* Display positions:
  *
@@ -30,7 +30,268 @@
 static const byte x_pos[] = { 1, 65, 1, 65};
 static const byte y_pos[] = { 2,  2, 5,  5};
 
-SSD1306AsciiWire display;
+/* Row numbers of the link screen, labels are PROGMEM strings */
+static const char row_label[TPMS_433_NUM_SENSORS][2] PROGMEM = { "0", "1", "2", "3" };
+
+/*
+ * Large glyphs for the values of the sensor screens.
+ *
+ * Adafruit5x7 scaled to 10x16 pixel, 2 pages of 10 columns per glyph.
+ * Sent as display data instead of scaling the font on every refresh.
+ */
+#define BIG_GLYPH_POINT     10
+#define BIG_GLYPH_MINUS     11
+#define BIG_GLYPH_C         12
+#define BIG_GLYPH_DEGREE    13
+#define BIG_GLYPH_NONE      255
+
+static const byte big_glyphs[][2 * DISPLAY_BIG_GLYPH_W] PROGMEM = {
+  0xFC, 0xFC, 0x03, 0x03, 0xC3, 0xC3, 0x33, 0x33, 0xFC, 0xFC, 0x0F, 0x0F, 0x33, 0x33, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F,  // 0
+  0x00, 0x00, 0x0C, 0x0C, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x30, 0x3F, 0x3F, 0x30, 0x30, 0x00, 0x00,  // 1
+  0x0C, 0x0C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0x3C, 0x3C, 0x3F, 0x3F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,  // 2
+  0x03, 0x03, 0x03, 0x03, 0xC3, 0xC3, 0xF3, 0xF3, 0x0F, 0x0F, 0x0C, 0x0C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F,  // 3
+  0xC0, 0xC0, 0x30, 0x30, 0x0C, 0x0C, 0xFF, 0xFF, 0x00, 0x00, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x3F, 0x3F, 0x03, 0x03,  // 4
+  0x3F, 0x3F, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0xC3, 0xC3, 0x0C, 0x0C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F,  // 5
+  0xF0, 0xF0, 0xCC, 0xCC, 0xC3, 0xC3, 0xC3, 0xC3, 0x03, 0x03, 0x0F, 0x0F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F,  // 6
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0xC3, 0xC3, 0x3F, 0x3F, 0x30, 0x30, 0x0C, 0x0C, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00,  // 7
+  0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0x3C, 0x3C, 0x0F, 0x0F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F,  // 8
+  0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFC, 0xFC, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0C, 0x0C, 0x03, 0x03,  // 9
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x3C, 0x3C, 0x3C, 0x00, 0x00, 0x00, 0x00,  // .
+  0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // -
+  0xFC, 0xFC, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x0C, 0x0C, 0x0F, 0x0F, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0C, 0x0C,  // C
+  0x00, 0x00, 0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0x3C, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // degree
+};
+
+/*
+ * I2C transmit queue
+ *
+ * The display writes are queued as transactions of
+ * [length][control byte][data ...] and sent by the TWI interrupt.
+ * Consecutive transactions are chained with a repeated start.
+ * loop() only waits if the queue is full, see twi_send().
+ */
+static volatile byte twi_queue[DISPLAY_TWI_QUEUE];
+static volatile byte twi_head = 0;      // written by loop()
+static volatile byte twi_tail = 0;      // read by the interrupt
+static volatile byte twi_used = 0;      // bytes in the queue
+static volatile byte twi_remain = 0;    // bytes left of the current transaction
+static volatile bool twi_active = false;
+static byte twi_addr;
+static bool twi_lost = false;           // queue dropped, screen must be redrawn
+
+static inline byte twi_pop()
+{
+  byte b = twi_queue[twi_tail];
+
+  twi_tail = (twi_tail + 1) & (DISPLAY_TWI_QUEUE - 1);
+  twi_used--;
+
+  return b;
+}
+
+ISR( TWI_vect)
+{
+  switch( TW_STATUS) {
+
+  case TW_START:
+  case TW_REP_START:
+    twi_remain = twi_pop();
+    TWDR = twi_addr << 1;
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+    break;
+
+  case TW_MT_SLA_ACK:
+  case TW_MT_DATA_ACK:
+    if( twi_remain > 0) {
+      twi_remain--;
+      TWDR = twi_pop();
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+    } else if( twi_used > 0) {
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+    } else {
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+      twi_active = false;
+    }
+    break;
+
+  default:
+    /* NACK, arbitration lost or bus error: drop the transaction */
+    statistics.display_errors++;
+    while( twi_remain > 0) {
+      twi_remain--;
+      twi_pop();
+    }
+    if( twi_used > 0) {
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTO) | _BV(TWSTA);
+    } else {
+      TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+      twi_active = false;
+    }
+  }
+}
+
+/* Wait for TWINT without interrupts, false on timeout */
+static bool twi_poll()
+{
+  unsigned long start = micros();
+
+  while( !(TWCR & _BV(TWINT))) {
+    if( micros() - start > DISPLAY_TWI_PROBE_usec) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Set up the TWI at DISPLAY_TWI_FREQ and check if a device
+ * acknowledges 'addr'. Called before the interrupt is used.
+ */
+static bool twi_begin( byte addr)
+{
+  bool found = false;
+
+  twi_addr = addr;
+
+  /* Internal pull-ups as the Wire library */
+  digitalWrite( SDA, HIGH);
+  digitalWrite( SCL, HIGH);
+
+  TWSR = 0;
+  TWBR = ((F_CPU / DISPLAY_TWI_FREQ) - 16) / 2;
+
+  TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTA);
+  if( twi_poll() && TW_STATUS == TW_START) {
+    TWDR = addr << 1;
+    TWCR = _BV(TWINT) | _BV(TWEN);
+    found = twi_poll() && TW_STATUS == TW_MT_SLA_ACK;
+  }
+  TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+
+  return found;
+}
+
+static inline byte twi_free()
+{
+  return DISPLAY_TWI_QUEUE - twi_used;
+}
+
+/*
+ * The bus or the display hangs: reset the TWI and drop the queue.
+ * Display::timeout() draws the screen again.
+ */
+static void twi_reset()
+{
+  cli();
+  TWCR = 0;
+  twi_head = twi_tail = 0;
+  twi_used = 0;
+  twi_remain = 0;
+  twi_active = false;
+  TWCR = _BV(TWEN);
+  sei();
+
+  twi_lost = true;
+  statistics.display_errors++;
+}
+
+/*
+ * Queue one transaction. Waits while the queue is full,
+ * the display scheduler avoids this by checking twi_free() first.
+ * After DISPLAY_TWI_TIMEOUT_usec without progress the TWI is reset.
+ */
+static void twi_send( byte control, const byte *data, byte len)
+{
+  unsigned long start = micros();
+  bool idle;
+
+  while( twi_free() < len + 2) {
+    if( micros() - start > DISPLAY_TWI_TIMEOUT_usec) {
+      twi_reset();
+      return;
+    }
+  }
+
+  twi_queue[twi_head] = len + 1;
+  twi_head = (twi_head + 1) & (DISPLAY_TWI_QUEUE - 1);
+  twi_queue[twi_head] = control;
+  twi_head = (twi_head + 1) & (DISPLAY_TWI_QUEUE - 1);
+  for( byte i = 0; i < len; i++) {
+    twi_queue[twi_head] = data[i];
+    twi_head = (twi_head + 1) & (DISPLAY_TWI_QUEUE - 1);
+  }
+
+  cli();
+  twi_used += len + 2;
+  idle = !twi_active;
+  sei();
+
+  if( idle) {
+    /* The interrupt is off, wait until the previous STOP was sent */
+    start = micros();
+    while( TWCR & _BV(TWSTO)) {
+      if( micros() - start > DISPLAY_TWI_TIMEOUT_usec) {
+        twi_reset();
+        return;
+      }
+    }
+
+    cli();
+    twi_active = true;
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+    sei();
+  }
+}
+
+/*
+ * SSD1306Ascii on the TWI queue.
+ *
+ * Commands and display data are collected until the mode changes or
+ * DISPLAY_TWI_BATCH bytes are reached and then queued as one transaction.
+ * Also counts the bytes sent to the display.
+ */
+class DisplayTwi : public SSD1306Ascii {
+
+  public:
+    unsigned int bytes = 0;
+
+    void begin( const DevType* dev) {
+      init( dev);
+      flush();
+    }
+
+    /* Write one byte of display data at the cursor */
+    void writeRam( byte b) {
+      writeDisplay( b, SSD1306_MODE_RAM);
+    }
+
+    /* Queue the collected bytes */
+    void flush() {
+      if( batch_len > 0) {
+        twi_send( batch_control, batch, batch_len);
+        batch_len = 0;
+      }
+    }
+
+  protected:
+    void writeDisplay( uint8_t b, uint8_t mode) {
+      byte control = mode == SSD1306_MODE_CMD ? 0x00 : 0x40;
+
+      if( batch_len > 0 && (control != batch_control || batch_len == DISPLAY_TWI_BATCH)) {
+        flush();
+      }
+      batch_control = control;
+      batch[batch_len++] = b;
+      bytes++;
+    }
+
+  private:
+    byte batch[DISPLAY_TWI_BATCH];
+    byte batch_len = 0;
+    byte batch_control;
+};
+
+DisplayTwi display;
 
 /*
  * This function is called once when the MC boots up.
@@ -65,32 +326,30 @@ size_t Display::setup(unsigned int eepromLocation)
     EEPROM.put( eepromLocation, displayConfig);
   }
   
-  Wire.begin();
-  Wire.setClock(400000L);
-
-  Wire.beginTransmission( DISPLAY_I2C_ADDRESS);
-  if (Wire.endTransmission() == 0) {
+  if( twi_begin( DISPLAY_I2C_ADDRESS)) {
     
     /* Display found */
     display_present = true;
 
     switch( displayConfig.device) {
       case DISPLAY_DEVICE_SH1106:
-        display.begin(&SH1106_128x64, DISPLAY_I2C_ADDRESS);
+        display.begin(&SH1106_128x64);
         break;
 
       case DISPLAY_DEVICE_SDD1306:
-        display.begin(&Adafruit128x64, DISPLAY_I2C_ADDRESS);
+        display.begin(&Adafruit128x64);
         break;
 
       default:
-        display.begin(&SH1106_128x64, DISPLAY_I2C_ADDRESS);  
+        display.begin(&SH1106_128x64);  
     }
     
     display.setFont(Adafruit5x7);
     display.clear();
+    clear_fields();
   
     show_title();
+    display.flush();
   }
 
   return (size_t)sizeOfConfig;
@@ -108,13 +367,47 @@ const char *Display::getName()
 void Display::timeout()
 {
   unsigned long now = millis();
-  bool full_refresh = false;
+  unsigned long start;
+  unsigned int stall;
 
   if( !display_present) {
     return;
   }
 
-  if( now >= last_update + DISPLAY_UPDATE_msec) {
+  /* Back-pressure: every step starts with an empty I2C queue.
+   * A step queues at most DISPLAY_TWI_QUEUE bytes, so loop() does
+   * not wait for the bus.
+   */
+  if( twi_free() < DISPLAY_TWI_QUEUE) {
+    if( now - queue_empty_ms > DISPLAY_TWI_TIMEOUT_usec / 1000) {
+      twi_reset();
+    } else {
+      return;
+    }
+  }
+  queue_empty_ms = now;
+
+  if( twi_lost) {
+    /* The I2C queue was dropped, draw the whole screen again */
+    twi_lost = false;
+    clear_fields();
+    clear_step = 0;
+  }
+
+  start = micros();
+
+  if( clear_step < DISPLAY_CLEAR_STEPS) {
+    /* New screen: clear half a row per step, then draw it */
+    display.clear( (clear_step & 1) * 64, (clear_step & 1) * 64 + 63, clear_step / 2, clear_step / 2);
+    if( ++clear_step == DISPLAY_CLEAR_STEPS) {
+      full_pending = true;
+    }
+
+  } else if( full_pending || labels_pending || fields_pending) {
+    update_display( full_pending || labels_pending);
+    full_pending = false;
+
+  } else if( now >= last_update + DISPLAY_UPDATE_msec) {
 
     switch( displayConfig.mode) {
       case DISPLAY_MODE_SINGLE:
@@ -156,17 +449,33 @@ void Display::timeout()
         }
     }
     
-    if( current_screen != last_screen)
-    {
-      display.clear();
+    display.bytes = 0;
+
+    if( current_screen != last_screen) {
+      clear_fields();
       last_screen = current_screen;
-      full_refresh = true;
+      clear_step = 0;
+    } else {
+      update_display( false);
     }
     
-    update_display( tpmsReceiver.getSensors(), full_refresh);
-    
     /* Update last_update last because it is used in update_display() */
     last_update = now;
+
+  } else {
+    return;
+  }
+
+  display.flush();
+
+  statistics.display_bytes = display.bytes;
+  if( display.bytes > statistics.display_bytes_max) {
+    statistics.display_bytes_max = display.bytes;
+  }
+
+  stall = micros() - start;
+  if( stall > statistics.display_stall_usec) {
+    statistics.display_stall_usec = stall;
   }
 }
 
@@ -216,50 +525,243 @@ void Display::setConfig()
 
 void Display::show_title()
 {
-  display.setFont(Adafruit5x7);
-  display.set1X();             // Normal 1:1 pixel scale
-  display.setCursor(0, 0);
-  display.print( F(" Abarth TPMS Monitor"));
+  print_label( 0, 0, F(" Abarth TPMS Monitor"));
 }
 
 void Display::show_last_update()
 {
   unsigned int disp = (unsigned int)((millis() - sensor_update_ts) / 1000);
+  char s[DISPLAY_FIELD_LEN + 1];
 
-  if( last_disp != disp) {
+  if( last_disp != disp || resume) {
     last_disp = disp;
     /* Display last update indicator only if last update time > displayConfig.last_indicator
      */
     if( disp >= displayConfig.last_indicator) {
-      display.setFont(Adafruit5x7);
-      display.set1X();             // Normal 1:1 pixel scale
-      display.setCursor( 0, 1);
-      display.print( F("Last update"));
-      display.clear( 72, 127, 1, 1);
-      display.print( disp);
-      display.print( F(" sec"));
-    } else {      
-      display.clear( 0, 127, 1, 1);
+      if( !last_shown) {
+        /* The label needs most of the I2C queue, draw it at the start of a step */
+        display.flush();
+        if( twi_free() < DISPLAY_TWI_QUEUE) {
+          fields_pending = true;
+          return;
+        }
+        display.setFont(Adafruit5x7);
+        display.set1X();             // Normal 1:1 pixel scale
+        display.setCursor( 0, 1);
+        display.print( F("Last update"));
+        last_shown = true;
+      }
+      utoa( disp, s, 10);
+      strcat_P( s, PSTR(" sec"));
+      print_field( DISPLAY_FIELD_LAST_UPD, 72, 1, false, s);
+    } else if( last_shown) {
+      print_field( DISPLAY_FIELD_LAST_UPD, 72, 1, false, "");
+      display.flush();
+      if( fields_pending || twi_free() < DISPLAY_TWI_QUEUE) {
+        fields_pending = true;
+        return;
+      }
+      display.clear( 0, 65, 1, 1);   // "Last update"
+      last_shown = false;
     }
   }
 }
 
-void Display::update_display( tpms433_sensor_t sensor[], bool full)
+/*
+ * Forget what is on the display, called after display.clear().
+ */
+void Display::clear_fields()
+{
+  memset( field, 0, sizeof(field));
+  last_shown = false;
+  last_disp = 0xFFFF;
+  labels_done = 0;
+  labels_pending = false;
+}
+
+/*
+ * Print 'text' at pixel column x, row y.
+ *
+ * Only the glyphs that differ from the text printed last time into
+ * field 'f' are sent to the display. Glyphs beyond the end of 'text'
+ * are cleared. A glyph is 6 pixel wide and 1 row high, 12 x 2 if big.
+ *
+ * If the I2C queue has no room for the next glyph the field is left
+ * for the next step, see timeout().
+ */
+void Display::print_field( byte f, byte x, byte y, bool big, const char *text)
+{
+  char *cache = field[f];
+  byte w = big ? 12 : 6;
+  byte room = (big ? DISPLAY_GLYPH_BYTES_2X : DISPLAY_GLYPH_BYTES_1X) + DISPLAY_TWI_BATCH + 2;
+  char ch;
+  bool end = false;
+
+  display.setFont(Adafruit5x7);
+  if( big) {
+    display.set2X();
+  } else {
+    display.set1X();
+  }
+
+  for( byte i = 0; i < DISPLAY_FIELD_LEN; i++) {
+    end = end || text[i] == '\0';
+    ch = end ? '\0' : text[i];
+
+    if( cache[i] == ch) {
+      continue;
+    }
+
+    display.flush();
+    if( twi_free() < room) {
+      fields_pending = true;
+      return;
+    }
+
+    if( end) {
+      display.clear( x + i * w, x + i * w + w - 1, y, big ? y + 1 : y);
+    } else {
+      display.setCursor( x + i * w, y);
+      if( big && big_glyph( ch) != BIG_GLYPH_NONE) {
+        write_big( x + i * w, y, big_glyph( ch));
+      } else if( ch == DISPLAY_DEGREE) {
+        display.setFont(System5x7);
+        display.write( ch);
+        display.setFont(Adafruit5x7);
+      } else {
+        display.write( ch);
+      }
+    }
+    cache[i] = ch;
+  }
+}
+
+/*
+ * Print the label 'label' at pixel column x, row y.
+ *
+ * Labels are drawn once per screen, in the order of the calls.
+ * labels_done counts the glyphs already on the display. If the I2C
+ * queue has no room for the next glyph, this and all following labels
+ * are left for the next step, see timeout().
+ */
+void Display::print_label( byte x, byte y, const __FlashStringHelper *label)
+{
+  const char *p = (const char *)label;
+  bool cursor = true;
+  char ch;
+
+  if( labels_pending) {
+    return;
+  }
+
+  display.setFont(Adafruit5x7);
+  display.set1X();
+
+  for( byte i = 0; (ch = pgm_read_byte( p + i)) != '\0'; i++, label_pos++) {
+    if( label_pos < labels_done) {
+      continue;
+    }
+
+    display.flush();
+    if( twi_free() < DISPLAY_GLYPH_BYTES_1X + DISPLAY_TWI_BATCH + 2) {
+      labels_pending = true;
+      return;
+    }
+
+    if( cursor) {
+      display.setCursor( x + i * 6, y);
+      cursor = false;
+    }
+    display.write( ch);
+    labels_done++;
+  }
+}
+
+/*
+ * Index of 'ch' in big_glyphs[]
+ */
+byte Display::big_glyph( char ch)
+{
+  if( ch >= '0' && ch <= '9') {
+    return ch - '0';
+  }
+
+  switch( ch) {
+    case '.':            return BIG_GLYPH_POINT;
+    case '-':            return BIG_GLYPH_MINUS;
+    case 'C':            return BIG_GLYPH_C;
+    case DISPLAY_DEGREE: return BIG_GLYPH_DEGREE;
+  }
+  return BIG_GLYPH_NONE;
+}
+
+/*
+ * Write big glyph 'g' at pixel column x, rows y and y+1,
+ * followed by 2 empty columns as set2X().
+ */
+void Display::write_big( byte x, byte y, byte g)
+{
+  for( byte page = 0; page < 2; page++) {
+    display.setCursor( x, y + page);
+    for( byte i = 0; i < DISPLAY_BIG_GLYPH_W; i++) {
+      display.writeRam( pgm_read_byte( &big_glyphs[g][page * DISPLAY_BIG_GLYPH_W + i]));
+    }
+    display.writeRam( 0);
+    display.writeRam( 0);
+  }
+}
+
+/*
+ * Print a statistics value right of the label in row y.
+ */
+void Display::print_value( byte f, byte y, unsigned long value)
+{
+  char s[11];
+
+  ultoa( value, s, 10);
+  print_field( f, 72, y, false, s);
+}
+
+/*
+ * " 22°C", s must hold 8 characters.
+ */
+void Display::format_temperature( float temp_c, char *s)
+{
+  byte len;
+
+  s[0] = ' ';
+  dtostrf(temp_c, 2, 0, &s[1]);
+  len = strlen(s);
+  s[len++] = DISPLAY_DEGREE;
+  s[len++] = 'C';
+  s[len] = '\0';
+}
+
+void Display::update_display( bool full)
 {  
+  unsigned long start = micros();
+  unsigned int render;
+
+  /* Continue the fields left out by the previous step */
+  resume = fields_pending;
+  fields_pending = false;
+  label_pos = 0;
+  labels_pending = false;
+
   switch( current_screen)
   {
   case DISPLAY_SCREEN_PRESSURE:
-    display_pressure( sensor, full);
+    display_pressure( full);
     show_last_update();
     break;
 
   case DISPLAY_SCREEN_TEMPERATURE:
-    display_temperature( sensor, full);
+    display_temperature( full);
     show_last_update();
     break;
     
   case DISPLAY_SCREEN_SETUP:
-    display_setup( sensor, full);
+    display_setup( full);
     show_last_update();
     break;
 
@@ -270,10 +772,28 @@ void Display::update_display( tpms433_sensor_t sensor[], bool full)
   case DISPLAY_SCREEN_STATISTICS2:
     display_statistics2( full);
     break;
+
+  case DISPLAY_SCREEN_STATISTICS3:
+    display_statistics3( full);
+    break;
+
+  case DISPLAY_SCREEN_LINK:
+    display_link( full);
+    break;
+
+  case DISPLAY_SCREEN_RENDER:
+    display_render( full);
+    break;
+  }
+
+  render = micros() - start;
+  statistics.display_render_usec = render;
+  if( render > statistics.display_render_max) {
+    statistics.display_render_max = render;
   }
 }
 
-void Display::display_setup(tpms433_sensor_t sensor[], bool full)
+void Display::display_setup(bool full)
 {
   byte i;
   int x;
@@ -283,114 +803,93 @@ void Display::display_setup(tpms433_sensor_t sensor[], bool full)
   
   if( full) show_title();
   
+  bool moved = tpmsReceiver.getOrderChanged() >= last_update;
+
   for (i = 0; i < 4; i++)
   {
-    if( full || sensor[i].last_update >= last_update) {
+    tpms433_sensor_t *sensor = tpmsReceiver.getSensor( i);
+
+    if( full || resume || moved || sensor->last_update >= last_update) {
 
-      if( sensor_update_ts == 0 || sensor_update_ts < sensor[i].last_update) {
-        sensor_update_ts = sensor[i].last_update;
+      if( sensor_update_ts == 0 || sensor_update_ts < sensor->last_update) {
+        sensor_update_ts = sensor->last_update;
       }
       
       x = x_pos[i];
       y = y_pos[i];
 
-      display.setFont(Adafruit5x7);
-      display.set2X();
-      display.clear(x, x+62, y, y+1);
-
-      dtostrf(sensor[i].press_bar, 3, 2, s);
-      display.print(s);
-
-      display.set1X();
-      display.clear(x, x+62, y+2, y+2);
+      dtostrf(sensor->press_cbar / 100.0, 3, 2, s);
+      print_field( i, x, y, true, s);
     
-      Tpms433::id2hex( sensor[i].sensorId, hexstr );   
+      Tpms433::id2hex( sensor->sensorId, hexstr );   
       hexstr[ 2 * TPMS_433_ID_LENGTH ] = '\0';
-      display.print(hexstr);
+      print_field( TPMS_433_NUM_SENSORS + i, x, y+2, false, hexstr);
     }
   }
 }
 
-void Display::display_temperature(tpms433_sensor_t sensor[], bool full)
+void Display::display_temperature(bool full)
 {
   byte i;
   int x;
   int y;
-  char s[6];
+  char s[8];
 
   if( full) show_title();
   
+  bool moved = tpmsReceiver.getOrderChanged() >= last_update;
+
   for (i = 0; i < 4; i++)
   {
-    if( full || sensor[i].last_update >= last_update) {
+    tpms433_sensor_t *sensor = tpmsReceiver.getSensor( i);
 
-      if( sensor_update_ts == 0 || sensor_update_ts < sensor[i].last_update) {
-        sensor_update_ts = sensor[i].last_update;
+    if( full || resume || moved || sensor->last_update >= last_update) {
+
+      if( sensor_update_ts == 0 || sensor_update_ts < sensor->last_update) {
+        sensor_update_ts = sensor->last_update;
       }
 
       x = x_pos[i];
       y = y_pos[i];
   
-      display.setFont(Adafruit5x7);
-      display.set2X();
-      display.clear(x, x+62, y, y+1);
-      
-      dtostrf(sensor[i].temp_c, 2, 0, s);
-      display.print(" ");
-      display.print(s);      
-      display.setFont(System5x7);
-      display.print(char(128));  //degrees symbol
-      display.setFont(Adafruit5x7);
-      display.print("C");
-
-      display.set1X();
-      display.clear(x, x+62, y+2, y+2);
-
-      dtostrf(sensor[i].press_bar, 3, 2, s);
-      display.print(s);
+      format_temperature( sensor->temp_c, s);
+      print_field( i, x, y, true, s);
+
+      dtostrf(sensor->press_cbar / 100.0, 3, 2, s);
+      print_field( TPMS_433_NUM_SENSORS + i, x, y+2, false, s);
     }
   }
 }
 
-void Display::display_pressure(tpms433_sensor_t sensor[], bool full)
+void Display::display_pressure(bool full)
 {
   byte i;
   int x;
   int y;
-  char s[6];
+  char s[8];
   
   if( full) show_title();
   
+  bool moved = tpmsReceiver.getOrderChanged() >= last_update;
+
   for (i = 0; i < 4; i++)
   {
-    if( full || sensor[i].last_update >= last_update) {
+    tpms433_sensor_t *sensor = tpmsReceiver.getSensor( i);
+
+    if( full || resume || moved || sensor->last_update >= last_update) {
 
-      if( sensor_update_ts == 0 || sensor_update_ts < sensor[i].last_update) {
-        sensor_update_ts = sensor[i].last_update;
+      if( sensor_update_ts == 0 || sensor_update_ts < sensor->last_update) {
+        sensor_update_ts = sensor->last_update;
       }
 
       x = x_pos[i];
       y = y_pos[i];
  
-      display.setFont(Adafruit5x7);
-      display.set2X();      
-      display.clear(x, x+62, y, y+1);
-
-      dtostrf(sensor[i].press_bar, 3, 2, s);
-      display.print(s);
-
-      display.set1X();
-      display.clear(x, x+62, y+2, y+2);
+      dtostrf(sensor->press_cbar / 100.0, 3, 2, s);
+      print_field( i, x, y, true, s);
  
-      dtostrf(sensor[i].temp_c, 2, 0, s);
-      display.print(" ");
-      display.print(s);
-      
-      display.setFont(System5x7);
-      display.print(char(128));  //degrees symbol
-      
-      display.setFont(Adafruit5x7);
-      display.print("C");
+      format_temperature( sensor->temp_c, s);
+      print_field( TPMS_433_NUM_SENSORS + i, x, y+2, false, s);
     }
   }
 }
@@ -401,35 +900,22 @@ void Display::display_statistics1( bool full)
   display.set1X();
 
   if( full) {
-    display.setCursor(0, 0);
-    display.print(F("Statistics"));
-
-    display.setCursor(0, 2);
-    display.print(F("version"));
-    display.setCursor(0, 3);
-    display.print(F("cs intr."));
-    display.setCursor(0, 4);
-    display.print(F("data intr."));
-    display.setCursor(0, 5);
-    display.print(F("max carr us"));
-    display.setCursor(0, 6);
-    display.print(F("carr detect"));
-    display.setCursor(0, 7);
-    display.print(F("data avail."));
-  }
-
-  display.setCursor(72, 2);
-  display.print(versionInfo);
-  display.setCursor(72, 3);
-  display.print(statistics.cs_interrupts);
-  display.setCursor(72, 4);
-  display.print(statistics.data_interrupts);
-  display.setCursor(72, 5);
-  display.print(statistics.carrier_len);  
-  display.setCursor(72, 6);
-  display.print(statistics.carrier_detected);
-  display.setCursor(72, 7);
-  display.print(statistics.data_available);
+    print_label( 0, 0, F("Statistics"));
+
+    print_label( 0, 2, F("version"));
+    print_label( 0, 3, F("cs intr."));
+    print_label( 0, 4, F("data intr."));
+    print_label( 0, 5, F("max carr us"));
+    print_label( 0, 6, F("carr detect"));
+    print_label( 0, 7, F("data avail."));
+  }
+
+  print_field( 0, 72, 2, false, versionInfo.c_str());
+  print_value( 1, 3, statistics.cs_interrupts);
+  print_value( 2, 4, statistics.data_interrupts);
+  print_value( 3, 5, statistics.carrier_len);
+  print_value( 4, 6, statistics.carrier_detected);
+  print_value( 5, 7, statistics.data_available);
 }
 
 void Display::display_statistics2( bool full)
@@ -438,31 +924,114 @@ void Display::display_statistics2( bool full)
   display.set1X();
 
   if( full) {
-    display.setCursor(0, 0);
-    display.print(F("Statistics"));
-
-    display.setCursor(0, 2);
-    display.print(F("max timings"));
-    display.setCursor(0, 3);
-    display.print(F("bit errors"));
-    display.setCursor(0, 4);
-    display.print(F("preamble ok"));
-    display.setCursor(0, 5);    
-    display.print(F("cksum ok"));
-    display.setCursor(0, 6);
-    display.print(F("cksum fails"));
-  }
-
-  display.setCursor(72, 2);
-  display.print(statistics.max_timings);
-  display.setCursor(72, 3);
-  display.print(statistics.bit_errors);
-  display.setCursor(72, 4);
-  display.print(statistics.preamble_found);
-  display.setCursor(72, 5);
-  display.print(statistics.checksum_ok);
-  display.setCursor(72, 6);
-  display.print(statistics.checksum_fails);
+    print_label( 0, 0, F("Statistics"));
+
+    print_label( 0, 2, F("max timings"));
+    print_label( 0, 3, F("bit errors"));
+    print_label( 0, 4, F("preamble ok"));
+    print_label( 0, 5, F("cksum ok"));
+    print_label( 0, 6, F("cksum fails"));
+  }
+
+  print_value( 0, 2, statistics.max_timings);
+  print_value( 1, 3, statistics.bit_errors);
+  print_value( 2, 4, statistics.preamble_found);
+  print_value( 3, 5, statistics.checksum_ok);
+  print_value( 4, 6, statistics.checksum_fails);
+}
+
+void Display::display_statistics3( bool full)
+{
+  display.setFont(Adafruit5x7);
+  display.set1X();
+
+  if( full) {
+    print_label( 0, 0, F("Statistics"));
+
+    print_label( 0, 2, F("cksum recov"));
+    print_label( 0, 3, F("dup/min"));
+    print_label( 0, 4, F("decode us"));
+
+    for( byte p = 0; p < TPMS_NUM_PROTOCOLS && p < 3; p++) {
+      print_label( 0, 5 + p, protocol_name( p));
+    }
+  }
+
+  print_value( 0, 2, statistics.checksum_recovered);
+  print_value( 1, 3, per_minute( statistics.duplicates));
+  print_value( 2, 4, statistics.max_decode_usec);
+
+  for( byte p = 0; p < TPMS_NUM_PROTOCOLS && p < 3; p++) {
+    print_value( 3 + p, 5 + p, protocol_decoded[p]);
+  }
+}
+
+/*
+ * Frames per minute, corrected frames in percent and
+ * average/minimum RSSI of the sensors at positions 0-3.
+ */
+void Display::display_link( bool full)
+{
+  char s[DISPLAY_FIELD_LEN + 1];
+
+  display.setFont(Adafruit5x7);
+  display.set1X();
+
+  if( full) {
+    print_label( 0, 0, F("Link"));
+
+    print_label( 0, 2, F("#  F/m   E%  avg  min"));
+  }
+
+  for( byte i = 0; i < TPMS_433_NUM_SENSORS; i++) {
+    tpms433_link_t *link = tpmsReceiver.getLink( i);
+
+    if( full) {
+      print_label( 0, 3 + i, (const __FlashStringHelper *)row_label[i]);
+    }
+
+    s[0] = '\0';
+    if( link->frames > 0) {
+      dtostrf(tpmsReceiver.getFrameRate( i), 5, 0, s);
+      dtostrf(tpmsReceiver.getErrorRatio( i), 5, 0, &s[5]);
+    }
+    print_field( 2 * i, 6, 3 + i, false, s);
+
+    s[0] = '\0';
+    if( link->frames > 0 && link->rssi_min != 0) {
+      dtostrf(link->rssi_avg / 16, 5, 0, s);
+      dtostrf(link->rssi_min, 5, 0, &s[5]);
+    }
+    print_field( 2 * i + 1, 66, 3 + i, false, s);
+  }
+}
+
+/*
+ * Cost of the display refresh: CPU time of the last update_display()
+ * step, I2C bytes and the time loop() was blocked, see timeout().
+ */
+void Display::display_render( bool full)
+{
+  display.setFont(Adafruit5x7);
+  display.set1X();
+
+  if( full) {
+    print_label( 0, 0, F("Render"));
+
+    print_label( 0, 2, F("render us"));
+    print_label( 0, 3, F("render max"));
+    print_label( 0, 4, F("i2c bytes"));
+    print_label( 0, 5, F("bytes max"));
+    print_label( 0, 6, F("stall us"));
+    print_label( 0, 7, F("i2c errors"));
+  }
+
+  print_value( 0, 2, statistics.display_render_usec);
+  print_value( 1, 3, statistics.display_render_max);
+  print_value( 2, 4, statistics.display_bytes);
+  print_value( 3, 5, statistics.display_bytes_max);
+  print_value( 4, 6, statistics.display_stall_usec);
+  print_value( 5, 7, statistics.display_errors);
 }
 
 #endif
@@ -0,0 +1,88 @@
+/*
+ * led_effects.h
+ * 
+ * LED effects on the RGB LED and the WS2801 strip,
+ * driven by sensor values without the host.
+ * 
+ */
+
+#ifdef LED_EFFECTS_SUPPORT
+
+#define FX_FRAME_msec          40   // 25 frames per second
+#define FX_BLINK_msec         250   // on and off time of FX_BLINK
+#define FX_FADE_msec         2000   // period of FX_FADE
+
+/* Outputs */
+#define FX_OUT_RGB              0
+#define FX_OUT_STRIP            1
+#define FX_OUTPUTS              2
+
+/* Source of the value an output is bound to */
+#define FX_SRC_NONE             0
+#define FX_SRC_TPMS_PRESS       1   // tire pressure in 1/100 bar, lowest and highest of sensors 0-3
+#define FX_SRC_OIL_PRESS        2   // 1/100 bar
+#define FX_SRC_OIL_TEMP         3   // C
+#define FX_SRC_MAX              3
+
+/* Effects */
+#define FX_OFF                  0   // LEDs off, output not used if both effects are off
+#define FX_STATIC               1
+#define FX_BLINK                2
+#define FX_FADE                 3
+#define FX_BAR                  4   // value from LO to HI, from red to the color
+#define FX_EFFECT_MAX           4
+
+/* The value is out of range if it is ... */
+#define FX_ALERT_BELOW       0x01   // below LO
+#define FX_ALERT_ABOVE       0x02   // above HI
+
+/*
+ * Binding of one output, 11 bytes.
+ * While the value is out of range the alert effect is shown in red.
+ */
+typedef struct fx_binding_t {
+  byte source;
+  byte effect;
+  byte alert_effect;
+  byte alert;
+  int low;
+  int high;
+  byte color[3];
+} fx_binding_t;
+
+typedef struct fx_config_t {
+  fx_binding_t binding[FX_OUTPUTS];
+
+  /* checksum MUST BE LAST */
+  checksum_t checksum;
+} fx_config_t;
+
+class LedEffects : public Action {
+
+  private:
+    unsigned int configLocation;
+    fx_config_t fxConfig;
+    unsigned long last_frame = 0;
+    int value[FX_OUTPUTS];          // of the last frame
+    bool valid[FX_OUTPUTS];
+    bool alert[FX_OUTPUTS];
+
+  public:
+    size_t setup(unsigned int eepromLocation);
+    const char *getName();
+    void timeout();
+    void getData();
+    void sendData();
+    void sendConfig();
+    void setConfig();
+
+  private:
+    void render( byte out, unsigned long now);
+    bool read_source( byte source, int *low, int *high);
+    byte effect_level( byte effect, byte bar, unsigned long now);
+    byte scale_value( fx_binding_t *bind, int v);
+};
+
+LedEffects ledEffects;
+
+#endif
@@ -0,0 +1,355 @@
+/*
+ * led_effects.ino
+ * 
+ * LED effects on the RGB LED and the WS2801 strip,
+ * driven by sensor values without the host.
+ * 
+ * Every FX_FRAME_msec the value each output is bound to is read and the
+ * effect of the output is drawn. A new sensor reading is shown in the
+ * next frame. While the value is out of range (below LO and/or above HI)
+ * the alert effect is shown in red.
+ * 
+ * Supported functions:
+ * ====================
+ * 
+ * Query data: Yes
+ *   send value and alert state per output
+ *   
+ * Query config: Yes
+ *   send binding per output
+ *     Keys: O, SRC, FX, AFX, A, LO, HI, R, G, B
+ *   
+ * Set config: Yes
+ *   set binding of output O (0 = RGB LED, 1 = WS2801 strip)
+ *     Keys: SRC source, FX effect, AFX alert effect, A alert when
+ *           below LO (1), above HI (2) or both (3), LO, HI, R, G, B
+ *   Missing keys keep their value. The bindings are saved in EEPROM.
+ * 
+ */
+
+#ifdef LED_EFFECTS_SUPPORT
+
+static const byte fx_red[3] = { 255, 0, 0 };
+
+/* a for t = 0 to b for t = 255 */
+static inline byte fx_mix( byte a, byte b, byte t)
+{
+  return ((uint16_t)a * (255 - t) + (uint16_t)b * t) / 255;
+}
+
+size_t LedEffects::setup(unsigned int eepromLocation)
+{
+  size_t sizeOfConfig = sizeof(fxConfig);
+  
+  /* Remember where the configuration is stored in EEPROM */
+  configLocation = eepromLocation;
+  
+  EEPROM.get( eepromLocation, fxConfig);
+
+  if( fxConfig.checksum != computeChecksum( &fxConfig, sizeOfConfig)) {
+    /* No valid configuration found, all outputs off */
+    memset( (void*)&fxConfig, 0, sizeof(fxConfig));
+    fxConfig.checksum = computeChecksum( &fxConfig, sizeOfConfig);
+
+    EEPROM.put( eepromLocation, fxConfig);
+  }
+
+  memset( valid, 0, sizeof(valid));
+  memset( alert, 0, sizeof(alert));
+
+  return (size_t)sizeOfConfig;
+}
+
+const char *LedEffects::getName()
+{
+  return "FX";
+}
+
+/* Draw a frame every FX_FRAME_msec */
+void LedEffects::timeout()
+{
+  unsigned long now = millis();
+
+  if( now - last_frame < FX_FRAME_msec) {
+    return;
+  }
+  last_frame = now;
+
+#ifdef RGB_SUPPORT
+  render( FX_OUT_RGB, now);
+#endif
+#ifdef WS2801_SUPPORT
+  render( FX_OUT_STRIP, now);
+#endif
+}
+
+void LedEffects::getData()
+{
+  /* Nothing to do, the values are read every frame */
+}
+
+void LedEffects::sendData()
+{
+  for( byte out = 0; out < FX_OUTPUTS; out++) {
+    sendMoreDataStart();
+    Serial.print(F("out: "));
+    Serial.print(out);
+    Serial.print(F(" value: "));
+    if( valid[out]) {
+      Serial.print(value[out]);
+    } else {
+      Serial.print(F("-"));
+    }
+    Serial.print(F(" alert: "));
+    Serial.print(alert[out]);
+    sendMoreDataEnd();
+  }
+}
+
+void LedEffects::sendConfig()
+{
+  for( byte out = 0; out < FX_OUTPUTS; out++) {
+    fx_binding_t *bind = &fxConfig.binding[out];
+
+    sendMoreDataStart();
+    Serial.print(F("O="));
+    Serial.print(out);
+    Serial.print(F(" SRC="));
+    Serial.print(bind->source);
+    Serial.print(F(" FX="));
+    Serial.print(bind->effect);
+    Serial.print(F(" AFX="));
+    Serial.print(bind->alert_effect);
+    Serial.print(F(" A="));
+    Serial.print(bind->alert);
+    Serial.print(F(" LO="));
+    Serial.print(bind->low);
+    Serial.print(F(" HI="));
+    Serial.print(bind->high);
+    Serial.print(F(" R="));
+    Serial.print(bind->color[0]);
+    Serial.print(F(" G="));
+    Serial.print(bind->color[1]);
+    Serial.print(F(" B="));
+    Serial.print(bind->color[2]);
+    sendMoreDataEnd();
+  }
+}
+
+void LedEffects::setConfig()
+{
+  int out = getIntParam( "O", 0);
+  fx_binding_t *bind;
+  int source, effect, alert_effect, alert_mode;
+
+  if( out < 0 || out >= FX_OUTPUTS) {
+    flagError( ERROR_INVALID_PARAM);
+    return;
+  }
+  bind = &fxConfig.binding[out];
+
+  source = getIntParam( "SRC", bind->source);
+  effect = getIntParam( "FX", bind->effect);
+  alert_effect = getIntParam( "AFX", bind->alert_effect);
+  alert_mode = getIntParam( "A", bind->alert);
+
+  if( source < 0 || source > FX_SRC_MAX
+      || effect < 0 || effect > FX_EFFECT_MAX
+      || alert_effect < 0 || alert_effect > FX_EFFECT_MAX
+      || alert_mode < 0 || alert_mode > (FX_ALERT_BELOW | FX_ALERT_ABOVE)) {
+    flagError( ERROR_INVALID_PARAM);
+    return;
+  }
+
+  bind->source = source;
+  bind->effect = effect;
+  bind->alert_effect = alert_effect;
+  bind->alert = alert_mode;
+  bind->low = getIntParam( "LO", bind->low);
+  bind->high = getIntParam( "HI", bind->high);
+  bind->color[0] = getIntParam( "R", bind->color[0]);
+  bind->color[1] = getIntParam( "G", bind->color[1]);
+  bind->color[2] = getIntParam( "B", bind->color[2]);
+
+  fxConfig.checksum = computeChecksum( &fxConfig, sizeof(fxConfig));
+  EEPROM.put( configLocation, fxConfig);
+}
+
+
+/* ***************** PRIVATE *************************************************/
+
+
+/*
+ * Draw one frame of output 'out'.
+ * Outputs with both effects off are left to the host.
+ */
+void LedEffects::render( byte out, unsigned long now)
+{
+  fx_binding_t *bind = &fxConfig.binding[out];
+  const byte *color = bind->color;
+  byte effect = bind->effect;
+  byte bar = 0;
+  byte level;
+  int low, high;
+
+  if( bind->effect == FX_OFF && bind->alert_effect == FX_OFF) {
+    return;
+  }
+
+  valid[out] = read_source( bind->source, &low, &high);
+  alert[out] = false;
+
+  if( valid[out]) {
+    value[out] = low;
+    bar = scale_value( bind, low);
+    alert[out] = ((bind->alert & FX_ALERT_BELOW) && low < bind->low)
+                 || ((bind->alert & FX_ALERT_ABOVE) && high > bind->high);
+  }
+
+  if( alert[out]) {
+    effect = bind->alert_effect;
+    color = fx_red;
+  }
+
+  level = effect_level( effect, bar, now);
+
+#ifdef RGB_SUPPORT
+  if( out == FX_OUT_RGB) {
+    if( effect == FX_BAR) {
+      rgbLed.setRGB( fx_mix( fx_red[0], color[0], bar),
+                     fx_mix( fx_red[1], color[1], bar),
+                     fx_mix( fx_red[2], color[2], bar));
+    } else {
+      rgbLed.setRGB( fx_mix( 0, color[0], level),
+                     fx_mix( 0, color[1], level),
+                     fx_mix( 0, color[2], level));
+    }
+  }
+#endif
+
+#ifdef WS2801_SUPPORT
+  if( out == FX_OUT_STRIP) {
+    byte n = ledStrip.getCount();
+    byte lit = ((uint16_t)bar * n + 254) / 255;
+    byte t;
+
+    for( byte i = 0; i < n; i++) {
+      if( effect == FX_BAR) {
+        /* LEDs up to the value, from red to the color along the strip */
+        t = n > 1 ? (uint16_t)i * 255 / (n - 1) : 255;
+        if( i < lit) {
+          ledStrip.setPixel( i, fx_mix( fx_red[0], color[0], t),
+                                fx_mix( fx_red[1], color[1], t),
+                                fx_mix( fx_red[2], color[2], t));
+        } else {
+          ledStrip.setPixel( i, 0, 0, 0);
+        }
+      } else {
+        ledStrip.setPixel( i, fx_mix( 0, color[0], level),
+                              fx_mix( 0, color[1], level),
+                              fx_mix( 0, color[2], level));
+      }
+    }
+    ledStrip.show();
+  }
+#endif
+}
+
+/*
+ * Current value of 'source'. For the tire pressure 'low' is the lowest
+ * and 'high' the highest of the sensors 0-3, otherwise both are the same.
+ * False if there is no value.
+ */
+bool LedEffects::read_source( byte source, int *low, int *high)
+{
+  bool found = false;
+  int v;
+
+  switch( source) {
+
+#if defined(TPMS_433_SUPPORT)
+  case FX_SRC_TPMS_PRESS:
+    for( byte i = 0; i < TPMS_433_NUM_SENSORS; i++) {
+      tpms433_sensor_t *sensor = tpmsReceiver.getSensor( i);
+
+      if( id_is_empty( sensor->sensorId) || sensor->last_update == 0) {
+        continue;
+      }
+      v = sensor->press_cbar;
+      if( !found || v < *low) *low = v;
+      if( !found || v > *high) *high = v;
+      found = true;
+    }
+    return found;
+#elif defined(TPMS_BLE_SUPPORT)
+  case FX_SRC_TPMS_PRESS:
+    for( byte i = 0; i < TPMS_BLE_NUM_SENSORS; i++) {
+      if( tpmsPress[i] <= 0.0) {
+        continue;
+      }
+      v = (int)(tpmsPress[i] * 100.0);
+      if( !found || v < *low) *low = v;
+      if( !found || v > *high) *high = v;
+      found = true;
+    }
+    return found;
+#endif
+
+#ifdef OIL_SUPPORT
+  case FX_SRC_OIL_PRESS:
+  case FX_SRC_OIL_TEMP:
+    {
+      int16_t temp;
+      uint16_t press;
+
+      if( !oilSensor.readValues( &temp, &press)) {
+        return false;
+      }
+      *low = *high = source == FX_SRC_OIL_PRESS ? (int)press : temp / 10;
+    }
+    return true;
+#endif
+  }
+
+  return false;
+}
+
+/* Brightness 0-255 of 'effect' at time 'now', 'bar' for FX_BAR */
+byte LedEffects::effect_level( byte effect, byte bar, unsigned long now)
+{
+  unsigned int phase;
+
+  switch( effect) {
+  case FX_STATIC:
+    return 255;
+
+  case FX_BLINK:
+    return ((now / FX_BLINK_msec) & 1) ? 0 : 255;
+
+  case FX_FADE:
+    phase = now % FX_FADE_msec;
+    if( phase >= FX_FADE_msec / 2) {
+      phase = FX_FADE_msec - phase;
+    }
+    return (unsigned long)phase * 255 / (FX_FADE_msec / 2);
+
+  case FX_BAR:
+    return bar;
+  }
+
+  return 0;
+}
+
+/* 'v' from LO (0) to HI (255) */
+byte LedEffects::scale_value( fx_binding_t *bind, int v)
+{
+  if( v <= bind->low) {
+    return 0;
+  }
+  if( v >= bind->high) {
+    return 255;
+  }
+  return (long)(v - bind->low) * 255 / (bind->high - bind->low);
+}
+
+#endif
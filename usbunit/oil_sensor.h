@@ -7,11 +7,61 @@
 
 #ifdef OIL_SUPPORT
 
+/* Background sampling on AVR, see oil_sensor.ino
+ * OIL_ADC_SAMPLES = 4^OIL_ADC_EXTRA_BITS conversions are summed per result.
+ */
+#define OIL_ADC_CHANNELS        2
+#define OIL_ADC_TEMP            0
+#define OIL_ADC_PRESS           1
+#define OIL_ADC_EXTRA_BITS      2
+#define OIL_ADC_SAMPLES         16
+#define OIL_ADC_FILTER_SHIFT    2     // low pass: new = old + (result - old) / 4
+
+/* Conversion tables, OIL_TABLE_SIZE entries over the full ADC range.
+ * The input has OIL_RAW_BITS: the filtered value of the background
+ * sampling on AVR, the 12 bit analogRead() value on the RedBear.
+ */
+#define OIL_TABLE_SIZE          65
+#ifdef ARDUINO_GENERIC
+#define OIL_RAW_BITS            (10 + OIL_ADC_EXTRA_BITS + OIL_ADC_FILTER_SHIFT)
+#else
+#define OIL_RAW_BITS            12
+#endif
+#define OIL_TABLE_SHIFT         (OIL_RAW_BITS - 6)
+
+extern const int16_t oil_temp_table[OIL_TABLE_SIZE] PROGMEM;
+extern const int16_t oil_press_table[OIL_TABLE_SIZE] PROGMEM;
+
+/* Statistics windows over all ADC results (AVR only).
+ * Selected with usbget -q OIL -p W=n, reset with usbget -s OIL -p W=n.
+ */
+#define OIL_WINDOW_NONE         0
+#define OIL_WINDOW_QUERY        1     // since the last query with W=1
+#define OIL_WINDOW_SESSION      2     // peak hold since boot or reset
+#define OIL_WINDOWS             2
+
+#define OIL_RESULT_usec         (OIL_ADC_SAMPLES * OIL_ADC_CHANNELS * 1024UL)
+#define OIL_PRESS_LOW_cbar      100   // default low pressure threshold
+
+typedef struct oil_window_t {
+
+  unsigned long start;                // millis() at reset
+  uint16_t min[OIL_ADC_CHANNELS];     // raw, OIL_RAW_BITS
+  uint16_t max[OIL_ADC_CHANNELS];
+  unsigned long sum[OIL_ADC_CHANNELS];
+  uint16_t count[OIL_ADC_CHANNELS];   // halved together with sum on overflow
+  unsigned long below;                // pressure results below the threshold
+
+} oil_window_t;
+
 class OilSensor : public Action {
 
   private:
-    float oilTemp  = 0.0;
-    float oilPress = 0.0;
+    int16_t oilTemp  = 0;       // 0.1 C
+    uint16_t oilPress = 0;      // 0.01 bar
+    uint16_t oilPressLow = OIL_PRESS_LOW_cbar;
+    byte reportWindow = OIL_WINDOW_NONE;
+    oil_window_t report;        // copy of the selected window
 
   public:
     size_t setup(unsigned int eepromLocation);
@@ -22,9 +72,15 @@ class OilSensor : public Action {
     void sendConfig();
     void setConfig();
 
+    bool readValues( int16_t *temp, uint16_t *press);
+
   private:
-    float calcTemp(float tPinValue);
-    float calcPress(float pPinValue);
+    int16_t calcTemp( uint16_t raw);
+    uint16_t calcPress( uint16_t raw);
+    uint16_t pressToRaw( uint16_t cbar);
+    void send_window();
 };
 
+OilSensor oilSensor;
+
 #endif
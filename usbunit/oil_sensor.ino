@@ -11,18 +11,138 @@
  * 
  * Query data: Yes
  *   send oil temperature and pressure
+ *   Key:  W=1 adds min/max/mean/time below PL since the last query with W=1
+ *         W=2 the same since boot or reset (peak hold)
  *
- * Query config: No
+ * Query config: Yes
+ *   send low pressure threshold
  *   
- * Set config: No
+ * Set config: Yes
+ *   Key:  W=n resets window n
+ *   Key:  PL low pressure threshold in 1/100 bar (not saved in EEPROM),
+ *         below the sensor range end (10 bar)
  * 
  */
 
 #ifdef OIL_SUPPORT
 
+#ifdef ARDUINO_GENERIC
+/*
+ * Background sampling of the oil sensors.
+ *
+ * Every Timer0 overflow (1024 usec, the millis() timer) triggers an ADC
+ * conversion. The ADC interrupt sums OIL_ADC_SAMPLES conversions of one
+ * channel and decimates the sum to 12 bits, then it switches to the next
+ * channel. The mux is switched long before the next conversion starts.
+ * Every channel gets a new result each OIL_ADC_CHANNELS * 16 msec which
+ * is low pass filtered.
+ */
+static const byte oil_adc_pin[OIL_ADC_CHANNELS] = { OIL_T_PIN, OIL_P_PIN };
+
+volatile uint16_t oil_adc_filtered[OIL_ADC_CHANNELS];   // 1/OIL_ADC_SCALE steps
+volatile byte oil_adc_valid = 0;                         // bit per channel
+static uint16_t oil_adc_sum = 0;
+static byte oil_adc_count = 0;
+static byte oil_adc_channel = 0;
+
+#define OIL_ADC_ALL_VALID   ((1 << OIL_ADC_CHANNELS) - 1)
+
+volatile oil_window_t oil_window[OIL_WINDOWS];
+volatile uint16_t oil_press_low_raw = 0;
+
+/* Must be called with interrupts disabled */
+static void oil_window_reset( byte w)
+{
+  memset( (void*)&oil_window[w], 0, sizeof(oil_window_t));
+  oil_window[w].start = millis();
+}
+
+/* Add an unfiltered result to all windows, called from ISR */
+static inline void oil_window_add( byte channel, uint16_t raw)
+{
+  volatile oil_window_t *win;
+
+  for( byte w = 0; w < OIL_WINDOWS; w++) {
+    win = &oil_window[w];
+
+    if( win->count[channel] == 0 || raw < win->min[channel]) {
+      win->min[channel] = raw;
+    }
+    if( raw > win->max[channel]) {
+      win->max[channel] = raw;
+    }
+
+    if( win->count[channel] == 0xffff) {
+      /* Keep the mean, older results count less from now on */
+      win->sum[channel] >>= 1;
+      win->count[channel] >>= 1;
+    }
+    win->sum[channel] += raw;
+    win->count[channel]++;
+
+    if( channel == OIL_ADC_PRESS && raw < oil_press_low_raw) {
+      win->below++;
+    }
+  }
+}
+
+ISR( ADC_vect)
+{
+  uint16_t result;
+  byte bit;
+
+  oil_adc_sum += ADC;
+
+  if( ++oil_adc_count < OIL_ADC_SAMPLES) {
+    return;
+  }
+
+  result = oil_adc_sum >> OIL_ADC_EXTRA_BITS;    // 12 bit
+  bit = 1 << oil_adc_channel;
+
+  if( oil_adc_valid & bit) {
+    oil_adc_filtered[oil_adc_channel] += result - (oil_adc_filtered[oil_adc_channel] >> OIL_ADC_FILTER_SHIFT);
+  } else {
+    oil_adc_filtered[oil_adc_channel] = result << OIL_ADC_FILTER_SHIFT;
+    oil_adc_valid |= bit;
+  }
+
+  oil_window_add( oil_adc_channel, result << OIL_ADC_FILTER_SHIFT);
+
+  oil_adc_sum = 0;
+  oil_adc_count = 0;
+
+  if( ++oil_adc_channel >= OIL_ADC_CHANNELS) {
+    oil_adc_channel = 0;
+  }
+  ADMUX = _BV(REFS0) | (oil_adc_pin[oil_adc_channel] - A0);
+}
+
+/* AVcc reference as analogRead(), ADC clock 125 kHz at 16 MHz */
+static void oil_adc_start()
+{
+  cli();
+  DIDR0 |= _BV(OIL_T_PIN - A0) | _BV(OIL_P_PIN - A0);
+  ADMUX = _BV(REFS0) | (oil_adc_pin[0] - A0);
+  ADCSRB = _BV(ADTS2);                  // Trigger on Timer0 overflow
+  ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+  sei();
+}
+#endif
+
 size_t OilSensor::setup(unsigned int eepromLocation)
 {
-  /* Nothing to do */
+#ifdef ARDUINO_GENERIC
+  oil_press_low_raw = pressToRaw( oilPressLow);
+
+  cli();
+  for( byte w = 0; w < OIL_WINDOWS; w++) {
+    oil_window_reset( w);
+  }
+  sei();
+
+  oil_adc_start();
+#endif
 
   return (size_t)0;
 }
@@ -39,23 +159,38 @@ const char *OilSensor::getName()
 
 void OilSensor::getData()
 {
+  reportWindow = OIL_WINDOW_NONE;
+
   if( actionSimulate)
   {
     /* TESTING ONLY, GENERATE RANDOM OIL PRESSURE AND TEMPERATURE
      * Pressure: Two digits right of the dot.
      * Temperature: One digit right of the dot.
      */
-    oilTemp = (-100 + random(1200)) / 10.0; // -10.0 ... 120.0 C
-    oilPress = (0 + random(1000)) / 100.0; // 0.00 ... 10.00 bar
+    oilTemp = -100 + random(1200);  // -10.0 ... 120.0 C
+    oilPress = random(1000);        // 0.00 ... 10.00 bar
   }
   else 
   {
-    /* Real implementation goes here */
-    float tPinValue = analogRead(OIL_T_PIN);
-    oilTemp = calcTemp(tPinValue);
+    readValues( &oilTemp, &oilPress);
+
+#ifdef ARDUINO_GENERIC
+    reportWindow = getIntParam( "W", OIL_WINDOW_NONE);
+
+    if( reportWindow > OIL_WINDOWS) {
+      reportWindow = OIL_WINDOW_NONE;
+      flagError( ERROR_INVALID_PARAM);
+    }
 
-    float pPinValue = analogRead(OIL_P_PIN);
-    oilPress = calcPress(pPinValue);
+    if( reportWindow != OIL_WINDOW_NONE) {
+      cli();
+      memcpy( &report, (void*)&oil_window[reportWindow - 1], sizeof(report));
+      if( reportWindow == OIL_WINDOW_QUERY) {
+        oil_window_reset( reportWindow - 1);
+      }
+      sei();
+    }
+#endif
   }
 }
 
@@ -64,77 +199,261 @@ void OilSensor::sendData()
   /* oiltemp: xx oilpress: yy */
   sendMoreDataStart();
   Serial.print( "oiltemp: ");
-  Serial.print( oilTemp,1);
+  Serial.print( oilTemp / 10.0,1);
   Serial.print( " oilpress: ");
-  Serial.print( oilPress,2);
+  Serial.print( oilPress / 100.0,2);
   sendMoreDataEnd();
+
+#ifdef ARDUINO_GENERIC
+  if( reportWindow != OIL_WINDOW_NONE) {
+    send_window();
+  }
+#endif
 }
 
 void OilSensor::sendConfig()
 {
-  /* Not supported */
+  sendMoreDataStart();
+  Serial.print(F("PL="));
+  Serial.print(oilPressLow);
+  sendMoreDataEnd();
 }
 
 void OilSensor::setConfig()
 {
-  /* Not supported */
-}
+  int w = getIntParam( "W", -1);
+  int low = getIntParam( "PL", -1);
 
+  /* At or above the table end nothing is above the threshold */
+  if(    w > OIL_WINDOWS
+      || low >= (int16_t)pgm_read_word( &oil_press_table[OIL_TABLE_SIZE - 1])) {
+    flagError( ERROR_INVALID_PARAM);
+    return;
+  }
 
-/* ***************** PRIVATE *************************************************/
+  if( low >= 0) {
+    oilPressLow = low;
+  }
+
+#ifdef ARDUINO_GENERIC
+  cli();
+  oil_press_low_raw = pressToRaw( oilPressLow);
+  if( w > OIL_WINDOW_NONE) {
+    oil_window_reset( w - 1);
+  }
+  sei();
+#endif
+}
 
-#define OIL_ABSZERO  273.15
 
-/* Temperature sensor result is linear,
- * Pressure sensor is not.
- * Multiplier for curve calculation:
- * (5V²/(1023*2)) - (5V/4V)
- *  5V = board voltage
- *  4V = difference between 0.5V (lowest reading: 0 bar)
- *       and 4.5V (highest reading: 10 bar)
- * 
- * This also applies to the RedBear (3.3V board voltage)
- * since the sensor still gets and works with 5V.
- * 
- * But board specific: depending on OIL_MAXANALOGREAD!
+/*
+ * Current temperature (0.1 C) and pressure (0.01 bar).
+ * On AVR the latest filtered values of the background sampling,
+ * false if there are none yet.
  */
+bool OilSensor::readValues( int16_t *temp, uint16_t *press)
+{
+#ifdef ARDUINO_GENERIC
+  uint16_t tRaw, pRaw;
+  byte valid;
+
+  cli();
+  tRaw = oil_adc_filtered[OIL_ADC_TEMP];
+  pRaw = oil_adc_filtered[OIL_ADC_PRESS];
+  valid = oil_adc_valid;
+  sei();
+
+  if( valid != OIL_ADC_ALL_VALID) {
+    return false;
+  }
+
+  *temp = calcTemp(tRaw);
+  *press = calcPress(pRaw);
+#else
+  *temp = calcTemp(analogRead(OIL_T_PIN));
+  *press = calcPress(analogRead(OIL_P_PIN));
+#endif
+
+  return true;
+}
+
 
+/* ***************** PRIVATE *************************************************/
+
+/* Conversion tables, generated from the sensor curves below with
+ * test/oil_tables.cpp ("make tables", "make test" checks them).
+ * Entry i is the value at ADC code i * (MAXCODE + 1) / 64,
+ * temperature in 0.1 C, pressure in 0.01 bar.
+ *
+ * Temperature sensor (NTC, B-parameter equation):
+ *   T0 = 40 C, R0 = 5830 Ohm, T1 = 150 C, R1 = 316 Ohm
+ *   B  = T0 * T1 / (T1 - T0) * ln(R0 / R1)
+ *   RN = RV * (1 - code / MAXCODE) / (code / MAXCODE), RV = 1000 Ohm
+ *   T  = T0 * B / (B + T0 * ln(RN / R0))
+ *   limited to -40.0 .. 200.0 C
+ *
+ *   Max. interpolation error against the equation (both boards):
+ *     0.2 C from 40 to 160 C, 0.5 C from 0 to 40 C,
+ *     2.4 C from 160 to 200 C and 5.8 C below 0 C,
+ *   where the curve is steep between the first and last table entries.
+ *
+ * Pressure sensor (linear):
+ *   0.5V = 0 bar, 4.5V = 10 bar at 5V board voltage,
+ *   P = code * 5V / (MAXCODE * 0.4V/bar) - 1.25 with the code limited to PMIN .. PMAX.
+ *   This also applies to the RedBear (3.3V board voltage) since the sensor
+ *   still gets 5V.
+ *
+ *   REDBEAR_DUO:     MAXCODE 4095, PMIN 410, PMAX 3689
+ *   ARDUINO_GENERIC: MAXCODE 1023, PMIN 102, PMAX  922
+ */
 #ifdef REDBEAR_DUO
-  #define OIL_MAXANALOGREAD 4095.0
-  #define OIL_PMINVAL        410.0
-  #define OIL_PMAXVAL       3689.0
-  #define OIL_MULTIPLIER       0.0030525f
+const int16_t oil_temp_table[OIL_TABLE_SIZE] PROGMEM = {
+   -400,  -148,    -6,    86,   157,   215,   265,   309,
+    350,   387,   422,   454,   485,   515,   543,   571,
+    597,   623,   649,   674,   698,   722,   746,   770,
+    794,   817,   841,   864,   888,   912,   936,   960,
+    984,  1009,  1034,  1060,  1086,  1113,  1140,  1168,
+   1197,  1227,  1257,  1289,  1323,  1358,  1394,  1433,
+   1473,  1517,  1563,  1613,  1667,  1727,  1792,  1866,
+   1949,  2000,  2000,  2000,  2000,  2000,  2000,  2000,
+   2000
+};
+
+const int16_t oil_press_table[OIL_TABLE_SIZE] PROGMEM = {
+      0,     0,     0,     0,     0,     0,     0,    12,
+     31,    51,    70,    90,   109,   129,   149,   168,
+    188,   207,   227,   246,   266,   285,   305,   324,
+    344,   363,   383,   402,   422,   442,   461,   481,
+    500,   520,   539,   559,   578,   598,   617,   637,
+    656,   676,   696,   715,   735,   754,   774,   793,
+    813,   832,   852,   871,   891,   910,   930,   949,
+    969,   989,  1001,  1001,  1001,  1001,  1001,  1001,
+   1001
+};
 #endif
+
 #ifdef ARDUINO_GENERIC
-  #define OIL_MAXANALOGREAD 1023.0
-  #define OIL_PMINVAL        102.0
-  #define OIL_PMAXVAL        922.0
-  #define OIL_MULTIPLIER       0.0122189f
+const int16_t oil_temp_table[OIL_TABLE_SIZE] PROGMEM = {
+   -400,  -148,    -6,    86,   157,   215,   265,   310,
+    350,   387,   422,   454,   485,   515,   543,   571,
+    598,   624,   649,   674,   699,   723,   747,   771,
+    794,   818,   841,   865,   889,   912,   936,   961,
+    985,  1010,  1035,  1061,  1087,  1113,  1141,  1169,
+   1198,  1227,  1258,  1290,  1324,  1359,  1395,  1434,
+   1475,  1518,  1565,  1615,  1669,  1729,  1795,  1869,
+   1953,  2000,  2000,  2000,  2000,  2000,  2000,  2000,
+   2000
+};
+
+const int16_t oil_press_table[OIL_TABLE_SIZE] PROGMEM = {
+      0,     0,     0,     0,     0,     0,     0,    12,
+     31,    51,    71,    90,   110,   129,   149,   168,
+    188,   207,   227,   246,   266,   286,   305,   325,
+    344,   364,   383,   403,   422,   442,   462,   481,
+    501,   520,   540,   559,   579,   598,   618,   637,
+    657,   677,   696,   716,   735,   755,   774,   794,
+    813,   833,   853,   872,   892,   911,   931,   950,
+    970,   989,  1002,  1002,  1002,  1002,  1002,  1002,
+   1002
+};
 #endif
 
-float OilSensor::calcTemp(float tPinValue)
+/*
+ * Linear interpolation between two table entries.
+ * 'raw' has OIL_RAW_BITS, the upper 6 bits select the entry.
+ */
+static int16_t oil_interpolate( const int16_t table[], uint16_t raw)
 {
-  float T0 = 40 + OIL_ABSZERO;
-  float T1 = 150 + OIL_ABSZERO;
-  float R0 = 5830;
-  float R1 = 316;
-  float RV = 1000;
-  float VA_VB = tPinValue/OIL_MAXANALOGREAD;
-  float B = (T0 * T1) / (T1-T0) * log(R0/R1);
-  float RN = RV*(1-VA_VB)/VA_VB; /* CHANGED FOR SWITCHED DIRECTION, ALT.: RV*VA_VB / (1-VA_VB); */
+  byte idx = raw >> OIL_TABLE_SHIFT;
+  uint16_t frac = raw & ((1 << OIL_TABLE_SHIFT) - 1);
+  int16_t lo = pgm_read_word( &table[idx]);
+  int16_t hi = pgm_read_word( &table[idx + 1]);
 
-  return T0 * B / (B + T0 * log(RN/R0)) -OIL_ABSZERO;
+  return lo + (int16_t)(((long)(hi - lo) * frac) >> OIL_TABLE_SHIFT);
+}
+
+int16_t OilSensor::calcTemp( uint16_t raw)
+{
+  return oil_interpolate( oil_temp_table, raw);
 }
 
-float OilSensor::calcPress(float pPinValue)
-{  
-  if (pPinValue < OIL_PMINVAL) {
-    pPinValue = OIL_PMINVAL;
+uint16_t OilSensor::calcPress( uint16_t raw)
+{
+  return oil_interpolate( oil_press_table, raw);
+}
+
+/*
+ * Raw value at which the pressure reaches 'cbar', inverse of calcPress().
+ * Returns 0 if 'cbar' is below the table, so nothing is below it.
+ */
+uint16_t OilSensor::pressToRaw( uint16_t cbar)
+{
+  int16_t lo, hi;
+
+  if( cbar == 0) {
+    return 0;
   }
-  else if (pPinValue > OIL_PMAXVAL) {
-    pPinValue = OIL_PMAXVAL;
+
+  for( byte idx = 0; idx < OIL_TABLE_SIZE - 1; idx++) {
+    lo = pgm_read_word( &oil_press_table[idx]);
+    hi = pgm_read_word( &oil_press_table[idx + 1]);
+
+    if( (int16_t)cbar < hi) {
+      if( (int16_t)cbar <= lo) {
+        return (uint16_t)idx << OIL_TABLE_SHIFT;
+      }
+      return ((uint16_t)idx << OIL_TABLE_SHIFT)
+             + (((long)(cbar - lo) << OIL_TABLE_SHIFT) + hi - lo - 1) / (hi - lo);
+    }
   }
-  return pPinValue * OIL_MULTIPLIER - 1.25;
+
+  return 0xffff;
 }
 
+#ifdef ARDUINO_GENERIC
+/*
+ * Send the window copied by getData().
+ *
+ * window: 2 time: 3600.0
+ * oiltemp min: 20.5 max: 112.3 mean: 95.1
+ * oilpress min: 0.85 max: 6.20 mean: 3.75 below: 1.4
+ */
+void OilSensor::send_window()
+{
+  byte t = OIL_ADC_TEMP;
+  byte p = OIL_ADC_PRESS;
+
+  sendMoreDataStart();
+  Serial.print( F("window: "));
+  Serial.print( reportWindow);
+  Serial.print( F(" time: "));
+  Serial.print( (millis() - report.start) / 1000.0, 1);
+  sendMoreDataEnd();
+
+  if( report.count[t] == 0 || report.count[p] == 0) {
+    return;
+  }
+
+  sendMoreDataStart();
+  Serial.print( F("oiltemp min: "));
+  Serial.print( calcTemp( report.min[t]) / 10.0, 1);
+  Serial.print( F(" max: "));
+  Serial.print( calcTemp( report.max[t]) / 10.0, 1);
+  Serial.print( F(" mean: "));
+  Serial.print( calcTemp( report.sum[t] / report.count[t]) / 10.0, 1);
+  sendMoreDataEnd();
+
+  sendMoreDataStart();
+  Serial.print( F("oilpress min: "));
+  Serial.print( calcPress( report.min[p]) / 100.0, 2);
+  Serial.print( F(" max: "));
+  Serial.print( calcPress( report.max[p]) / 100.0, 2);
+  Serial.print( F(" mean: "));
+  Serial.print( calcPress( report.sum[p] / report.count[p]) / 100.0, 2);
+  Serial.print( F(" below: "));
+  Serial.print( report.below * (OIL_RESULT_usec / 1000000.0), 1);
+  sendMoreDataEnd();
+}
+#endif
+
 #endif
@@ -23,8 +23,9 @@ class RgbAnalog : public Action {
     void sendConfig();
     void setConfig();
 
-  private:
     void setRGB( byte r, byte g, byte b);
 };
 
+RgbAnalog rgbLed;
+
 #endif
@@ -71,10 +71,6 @@ void RgbAnalog::setConfig()
   setRGB( getIntParam("R", 0), getIntParam("G", 0),getIntParam("B", 0));
 }
 
-
-/* ***************** PRIVATE *************************************************/
-
-
 void RgbAnalog::setRGB( byte r, byte g, byte b)
 {
   red = r;
@@ -86,4 +82,8 @@ void RgbAnalog::setRGB( byte r, byte g, byte b)
   analogWrite(RGB_BLUE_PORT, b);
 }
 
+
+/* ***************** PRIVATE *************************************************/
+
+
 #endif
@@ -0,0 +1 @@
+/* Empty, cc1101.h includes it */
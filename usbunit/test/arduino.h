@@ -0,0 +1,46 @@
+/*
+ * arduino.h
+ *
+ * Minimal Arduino environment to compile the decoder on the host.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t byte;
+
+#define PROGMEM
+#define pgm_read_byte(p)      (*(const byte *)(p))
+#define pgm_read_word(p)      (*(p))
+#define memcpy_P              memcpy
+
+class __FlashStringHelper;
+#define F(s)                  ((const __FlashStringHelper *)(s))
+
+class SerialStub {
+  public:
+    void print( const __FlashStringHelper *s) { fputs( (const char *)s, stdout); }
+    void print( const char *s) { fputs( s, stdout); }
+    void print( unsigned long v) { printf( "%lu", v); }
+    void println( const __FlashStringHelper *s) { print( s); println(); }
+    void println( unsigned long v) { print( v); println(); }
+    void println() { putchar( '\n'); }
+};
+
+static SerialStub Serial;
+
+static unsigned long micros()
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+static unsigned long millis()
+{
+  return micros() / 1000;
+}
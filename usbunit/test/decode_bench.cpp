@@ -0,0 +1,335 @@
+/*
+ * decode_bench.cpp
+ *
+ * Host check of the TPMS frame decoder.
+ *
+ * 1. The fixed frames of frames.h go through decode_tpms(), the result,
+ *    protocol and sensor values must match the expected ones.
+ * 2. Synthetic timing arrays (noise, preamble 0xAAA9 and a 9 byte
+ *    Manchester coded frame of each protocol, some with a corrupted
+ *    pulse) and the fixed frames are decoded with the reference decoder
+ *    in decode_ref.h and with decode_frame() of tpms_decode.h, for every
+ *    protocol. Both must return the same bytes and length and the same
+ *    checksum result.
+ * 3. The time per frame of both decoders is printed.
+ *
+ * The reference classifies the timings itself, the current decoder gets
+ * the 2 bit pulse codes the receiver ISR stores. Classification is done
+ * outside of the timed loop.
+ */
+
+#include "arduino.h"
+
+#define CC1101_SUPPORT
+
+#include "../util.h"
+#include "../cc1101.h"
+
+namespace ref {
+#include "decode_ref.h"
+}
+
+#include "../tpms_decode.h"
+#include "frames.h"
+
+#define BENCH_FRAMES   20000
+#define BENCH_ROUNDS   10
+
+#define NUM_FIXTURES   (sizeof(fixtures) / sizeof(fixtures[0]))
+
+typedef struct benchFrame_t {
+  byte timings[CC1101_MAX_TIMINGS];
+  rxFrame_t frame;
+} benchFrame_t;
+
+static benchFrame_t bench[BENCH_FRAMES + NUM_FIXTURES];
+
+/* CRC-8 as used by renault, computed bitwise independent of checksum_crc8() */
+static byte crc8( const byte *data, byte count)
+{
+  byte crc = 0;
+
+  for( byte i = 0; i < count; i++) {
+    crc ^= data[i];
+    for( byte n = 0; n < 8; n++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+/*
+ * Pulse codes and weak pulses as stored by receive_edge()
+ */
+static void set_pulses( benchFrame_t *b, byte count)
+{
+  byte pulse, dist;
+  byte w, worst;
+
+  memset( &b->frame, 0, sizeof(b->frame));
+
+  for( int i = 0; i < count; i++) {
+    byte t = b->timings[i];
+
+    if( t < MIN_SHORT_usec) {
+      pulse = INVALID_PULSE;
+    } else if( t < MIN_LONG_usec) {
+      pulse = SHORT_PULSE;
+    } else {
+      pulse = LONG_PULSE;
+    }
+    b->frame.pulses[i / PULSES_PER_BYTE] |= pulse << ((i % PULSES_PER_BYTE) * PULSE_BITS);
+
+    if( pulse == INVALID_PULSE || t + CC1101_WEAK_PULSE_usec <= MIN_LONG_usec
+                               || t >= MIN_LONG_usec + CC1101_WEAK_PULSE_usec) {
+      continue;
+    }
+
+    dist = (t < MIN_LONG_usec) ? MIN_LONG_usec - t : t - MIN_LONG_usec;
+    if( b->frame.weak_count < CC1101_WEAK_PULSES) {
+      w = b->frame.weak_count++;
+    } else {
+      for( w = 1, worst = 0; w < CC1101_WEAK_PULSES; w++) {
+        if( b->frame.weak_dist[w] > b->frame.weak_dist[worst]) {
+          worst = w;
+        }
+      }
+      if( dist >= b->frame.weak_dist[worst]) {
+        continue;
+      }
+      w = worst;
+    }
+    b->frame.weak_idx[w] = i;
+    b->frame.weak_dist[w] = dist;
+  }
+  b->frame.count = count;
+}
+
+/*
+ * Build the timings of a frame.
+ * Every 4th frame is random noise, the others are frames of the
+ * protocols in turn. A third of them get one corrupted timing.
+ */
+static void make_frame( int n, benchFrame_t *b)
+{
+  static byte bits[400];
+  tpmsProtocol_t proto;
+  byte data[9];
+  int nbits = 0;
+  int count = 0;
+  int i, j;
+  bool first = 0;
+
+  if( n % 4 == 0) {
+    count = rand() % CC1101_MAX_TIMINGS;
+    for( i = 0; i < count; i++) {
+      b->timings[i] = 20 + rand() % 236;
+    }
+    first = rand() & 1;
+
+  } else {
+    memcpy_P( &proto, &tpms_protocol[(n / 4) % TPMS_NUM_PROTOCOLS], sizeof(proto));
+
+    for( i = 0; i < 8; i++) {
+      data[i] = rand();
+    }
+    if( proto.checksum == CHECKSUM_CRC8) {
+      data[8] = crc8( data, 8);
+    } else {
+      data[8] = 0;
+      for( i = 0; i < 8; i++) {
+        data[8] ^= data[i];
+      }
+    }
+
+    for( i = rand() % 20; i > 0; i--) {
+      bits[nbits++] = rand() & 1;
+    }
+    for( i = 15; i >= 0; i--) {
+      bits[nbits++] = (proto.preamble >> i) & 1;
+    }
+    for( i = 0; i < 72; i++) {
+      byte v = (data[i / 8] >> (7 - i % 8)) & 1;
+      bits[nbits++] = !v;
+      bits[nbits++] = v;
+    }
+
+    first = bits[0];
+    for( i = 0; i < nbits; i = j) {
+      for( j = i; j < nbits && bits[j] == bits[i]; j++)
+        ;
+      b->timings[count++] = (j - i == 1) ? 35 + rand() % 30 : 90 + rand() % 160;
+    }
+
+    if( rand() % 3 == 0) {
+      b->timings[rand() % count] = 20 + rand() % 236;
+    }
+  }
+
+  set_pulses( b, count);
+  b->frame.first_edge_state = first;
+}
+
+/*
+ * Decode the fixed frames and compare with the expected result.
+ * Returns the number of differences.
+ */
+static unsigned int check_fixtures()
+{
+  tpmsReading_t reading;
+  unsigned int diffs = 0;
+  byte result;
+
+  for( unsigned int f = 0; f < NUM_FIXTURES; f++) {
+    benchFrame_t *b = &bench[BENCH_FRAMES + f];
+
+    memcpy( b->timings, fixtures[f].timings, fixtures[f].count);
+    set_pulses( b, fixtures[f].count);
+    b->frame.first_edge_state = fixtures[f].first_edge_state;
+
+    memset( &reading, 0, sizeof(reading));
+    result = decode_tpms( &b->frame, &reading);
+
+    if(    result != fixtures[f].result
+        || (   result != DECODE_FAILED
+            && (   reading.protocol != fixtures[f].protocol
+                || memcmp( reading.id, fixtures[f].id, TPMS_ID_LENGTH) != 0
+                || reading.press_cbar != fixtures[f].press_cbar
+                || reading.temp_c != fixtures[f].temp_c))) {
+      printf( "fixture '%s': result %d protocol %d press %u temp %d\n",
+              fixtures[f].name, result, reading.protocol, reading.press_cbar, reading.temp_c);
+      diffs++;
+    }
+  }
+
+  return diffs;
+}
+
+/*
+ * Decode frame b with the reference and the current decoder for the
+ * protocol and compare. Returns true if both agree.
+ */
+static bool compare_decoders( benchFrame_t *b, tpmsProtocol_t *proto, unsigned int *ok)
+{
+  ref::bitArray_t ref_bits;
+  ref::bitArray_t ref_preamble;
+  ref::byteArray_t ref_data;
+  ref::bitLength_t ref_start;
+  byteArray_t data;
+  byteArray_t invalid;
+  bool ref_found, new_found;
+  bool ref_ok, new_ok;
+
+  /* Reference, without the truncation to 9 bytes of ref::decode_tpms() */
+  ref::clear_bit_array( &ref_preamble);
+  ref_preamble.bits[0] = proto->preamble >> 8;
+  ref_preamble.bits[1] = proto->preamble & 0xff;
+  ref_preamble.length = 16;
+
+  ref::bit_decode( b->timings, b->frame.count, b->frame.first_edge_state, &ref_bits);
+  ref_start = ref::find_preamble( &ref_bits, &ref_preamble);
+  ref_found = ref_start > 0;
+  ref::clear_byte_array( &ref_data);
+  if( ref_found) {
+    ref::manchester_decode( &ref_bits, ref_start, &ref_data);
+  }
+
+  /* The reference compares against byte 8 even if only 8 bytes were decoded,
+   * the only known difference. It needs the full length here.
+   */
+  if( proto->checksum == CHECKSUM_CRC8) {
+    ref_ok = ref_data.length >= proto->length && crc8( ref_data.bytes, 8) == ref_data.bytes[8];
+  } else {
+    ref_ok = ref_data.length >= proto->length && ref::check_checksum( &ref_data);
+  }
+
+  new_found = decode_frame( &b->frame, proto->preamble, &data, &invalid);
+  new_ok = check_frame( proto, &data);
+
+  if( ref_ok) {
+    (*ok)++;
+  }
+
+  return    ref_found == new_found
+         && ref_ok == new_ok
+         && ref_data.length == data.length
+         && memcmp( ref_data.bytes, data.bytes, data.length) == 0;
+}
+
+static double nsec_per_frame( struct timespec *start, struct timespec *end)
+{
+  return ((end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec))
+         / ((double)BENCH_FRAMES * BENCH_ROUNDS);
+}
+
+int main()
+{
+  tpmsProtocol_t proto;
+  ref::byteArray_t ref_data;
+  byteArray_t data;
+  byteArray_t invalid;
+  struct timespec start, end;
+  unsigned int fixture_diffs;
+  unsigned int diffs = 0;
+  unsigned int ok[TPMS_NUM_PROTOCOLS];
+  volatile unsigned int sink = 0;
+  unsigned int n, p;
+  int r;
+
+  srand( 1);
+
+  for( n = 0; n < BENCH_FRAMES; n++) {
+    make_frame( n, &bench[n]);
+  }
+
+  /* Fixed frames, also adds them to bench[] */
+  fixture_diffs = check_fixtures();
+
+  printf( "fixtures    %u\n", (unsigned int)NUM_FIXTURES);
+  printf( "fixture differences %u\n", fixture_diffs);
+
+  /* Equivalence, all protocols */
+  for( p = 0; p < TPMS_NUM_PROTOCOLS; p++) {
+    memcpy_P( &proto, &tpms_protocol[p], sizeof(proto));
+    ok[p] = 0;
+
+    for( n = 0; n < BENCH_FRAMES + NUM_FIXTURES; n++) {
+      if( !compare_decoders( &bench[n], &proto, &ok[p])) {
+        diffs++;
+      }
+    }
+  }
+
+  printf( "frames      %u\n", (unsigned int)(BENCH_FRAMES + NUM_FIXTURES));
+  for( p = 0; p < TPMS_NUM_PROTOCOLS; p++) {
+    printf( "checksum ok %u ", ok[p]);
+    Serial.println( protocol_name( p));
+  }
+  printf( "differences %u\n", diffs);
+
+  /* Timing, protocol abarth124 as the reference knows no other */
+  memcpy_P( &proto, &tpms_protocol[0], sizeof(proto));
+
+  clock_gettime( CLOCK_MONOTONIC, &start);
+  for( r = 0; r < BENCH_ROUNDS; r++) {
+    for( n = 0; n < BENCH_FRAMES; n++) {
+      sink += ref::decode_tpms( bench[n].timings, bench[n].frame.count,
+                                bench[n].frame.first_edge_state, &ref_data);
+    }
+  }
+  clock_gettime( CLOCK_MONOTONIC, &end);
+  printf( "reference   %.0f ns/frame\n", nsec_per_frame( &start, &end));
+
+  clock_gettime( CLOCK_MONOTONIC, &start);
+  for( r = 0; r < BENCH_ROUNDS; r++) {
+    for( n = 0; n < BENCH_FRAMES; n++) {
+      sink += decode_frame( &bench[n].frame, proto.preamble, &data, &invalid)
+              && check_frame( &proto, &data);
+    }
+  }
+  clock_gettime( CLOCK_MONOTONIC, &end);
+  printf( "current     %.0f ns/frame\n", nsec_per_frame( &start, &end));
+
+  return (diffs == 0 && fixture_diffs == 0) ? 0 : 1;
+}
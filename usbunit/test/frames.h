@@ -0,0 +1,102 @@
+/*
+ * frames.h
+ *
+ * Fixed frames for decode_bench.cpp with the expected decoder result.
+ *
+ * Each frame is a timing array in usec as receive_edge() measures it,
+ * starting with the level of the first edge. There are no captures of
+ * real sensors in the tree yet. These frames are built from sensor
+ * data with timing jitter and some noise before the preamble. Captured
+ * frames can be appended in the same format.
+ */
+
+typedef struct fixture_t {
+  const char *name;
+  bool first_edge_state;
+  byte count;
+  byte result;                  // DECODE_*
+  byte protocol;                // Index into tpms_protocol[]
+  byte id[TPMS_ID_LENGTH];
+  unsigned int press_cbar;
+  int temp_c;
+  byte timings[CC1101_MAX_TIMINGS];
+} fixture_t;
+
+static const fixture_t fixtures[] = {
+  { "abarth124 clean", 1, 123, DECODE_OK, 0, { 0x1A, 0x2B, 0x3C, 0x4D }, 248, 20,
+    {
+       50,  42,  47,  43,  55,  50,  53,  43,  52,  47,  54,  51,  55,  92, 109,  57,
+       55,  42,  49,  98,  45,  54, 102,  98,  96,  54,  48,  53,  51, 104,  97,  95,
+      106, 108,  45,  54, 110,  57,  45, 111,  56,  44,  46,  54,  49,  47, 106,  58,
+       43,  56,  54, 112, 103,  56,  44,  97,  44,  58,  93,  93,  99,  58,  45,  57,
+       57,  57,  44,  57,  42,  57,  49, 104,  97,  99,  92, 102,  58,  53, 107, 105,
+       96,  57,  58,  52,  53,  94, 111,  43,  50,  54,  44,  95,  54,  48, 108,  48,
+       55,  49,  44,  94,  43,  43,  47,  45,  47,  44,  98,  48,  47,  93, 105,  57,
+       57,  42,  43,  94,  56,  53,  94,  44,  55,  55, 172,
+    } },
+  { "abarth124 jitter and noise before the preamble", 1, 126, DECODE_OK, 0, { 0x0C, 0xA1, 0x55, 0x07 }, 234, 12,
+    {
+       50,  61,  87,  49,  56,  52,  59,  57,  52,  53,  47,  43,  46,  50,  52,  64,
+       40, 118, 109,  62,  46,  59,  38,  39,  50,  91,  54,  62, 106,  46,  45, 117,
+       95,  90, 119,  61,  36,  57,  59,  50,  47,  96,  91, 107,  91, 114,  88, 102,
+      118, 104, 103,  59,  57,  50,  40,  39,  44,  37,  62, 114,  39,  62,  60,  43,
+      112,  58,  49,  38,  64,  56,  49,  38,  48,  54,  51,  49,  54, 119,  50,  60,
+       98,  92,  95,  91, 118, 101, 107,  38,  50,  41,  60, 102,  63,  58,  63,  43,
+       38,  55,  40,  39, 115,  52,  49,  60,  64,  94,  48,  63,  48,  64,  43,  64,
+       86,  45,  57,  37,  47,  97, 120, 106,  91, 103,  39,  41, 116,  38,
+    } },
+  { "abarth124 long pulse received as short, recovered", 1, 125, DECODE_RECOVERED, 0, { 0x1A, 0x2B, 0x3C, 0x4D }, 251, 21,
+    {
+       58,  43,  51,  46,  53,  51,  44,  44,  54,  55,  53,  56,  54,  53,  44, 106,
+      107,  46,  50,  45,  48, 108,  57,  49,  96,  92,  95,  48,  55,  42,  53, 104,
+      112,  94,  95, 112,  42,  51,  97,  45,  55, 100,  42,  55,  46,  51,  46,  48,
+      101,  58,  44,  50,  43, 111, 107,  46,  56, 109,  58,  52,  93, 112, 100,  55,
+       47,  46,  48,  42,  46,  45,  55,  49,  42,  72,  92,  92, 111, 104,  51,  49,
+      107, 106,  52,  42, 100,  48,  56, 109,  94,  46,  51,  55,  55,  95,  56,  48,
+       50,  58, 106,  42,  45, 112,  56,  45,  56,  58,  47,  45, 112,  58,  42, 107,
+       95,  43,  42,  56,  56, 100,  44,  50,  56,  54,  52,  47,  55,
+    } },
+  { "renault clean", 1, 129, DECODE_OK, 1, { 0x00, 0x12, 0x34, 0x56 }, 240, 25,
+    {
+       46,  54,  52,  56,  46,  55,  45,  47,  58,  42,  44,  48,  57, 102, 107,  99,
+      105,  51,  49,  49,  50,  56,  46,  49,  46, 111,  96,  92, 104,  51,  48,  45,
+       58,  50,  47,  45,  55,  58,  46,  57,  45,  44,  52, 102,  43,  43, 112, 109,
+       53,  42,  58,  50,  93,  98, 104, 101, 102,  92,  45,  46,  92,  53,  58,  55,
+       45, 104,  48,  53, 111, 112, 107,  55,  49,  58,  49,  58,  58,  53,  51, 111,
+      109,  53,  45, 105,  94, 102,  50,  47,  52,  55,  56,  48,  52,  58,  47,  53,
+       44,  45,  49,  50,  98,  54,  42,  46,  47,  46,  45,  57,  51,  50,  45,  44,
+       54,  51,  51,  52,  53,  44,  50,  57,  43, 107, 109,  50,  58, 102,  45,  54,
+       50,
+    } },
+  { "renault jitter and noise before the preamble", 0, 133, DECODE_OK, 1, { 0x00, 0x0F, 0xED, 0xCB }, 225, 18,
+    {
+       95, 157,  48,  43,  51,  36,  40,  55,  45,  64,  57,  37,  36,  39, 106, 117,
+      103,  88,  59,  61,  45,  55,  56,  56,  55,  61,  86, 117,  52,  45, 118, 106,
+      100,  64,  55,  93,  40,  45,  38,  53,  50,  39, 103,  37,  43, 102,  58,  47,
+       63,  44,  43,  43, 113,  49,  41,  87,  50,  42, 110,  98, 102,  37,  44,  53,
+       56,  57,  53,  48,  39, 106, 118,  58,  53, 117,  88, 105,  62,  55,  40,  41,
+       60,  42, 103,  61,  36,  60,  61,  36,  51,  55,  54,  58,  59,  59,  63,  54,
+       45,  49,  64,  60,  62,  46,  49,  43,  57, 104,  44,  36,  38,  49,  39,  62,
+       62,  58,  47,  49,  53,  57,  61,  56, 105, 113,  98,  47,  62,  50,  44,  56,
+       53,  39,  57, 101,  61,
+    } },
+  { "abarth124 cut after 8 bytes", 1, 110, DECODE_FAILED, 0, { 0x00, 0x00, 0x00, 0x00 }, 0, 0,
+    {
+       45,  56,  50,  55,  44,  57,  47,  52,  46,  51,  51,  57,  52,  96, 107,  53,
+       44,  56,  45, 111,  42,  43, 109, 102,  98,  52,  47,  51,  50, 109,  96,  94,
+      106, 102,  48,  46,  94,  56,  54,  98,  46,  49,  52,  42,  53,  55, 110,  54,
+       42,  58,  57,  93,  96,  58,  58, 102,  58,  48, 109, 110, 106,  57,  44,  51,
+       52,  50,  57,  50,  48,  45,  48, 107,  99,  94,  95, 112,  52,  48, 100, 101,
+       94,  44,  51,  46,  53, 102, 103,  43,  53,  43,  57,  95,  47,  42, 105,  56,
+       56,  49,  51, 109,  48,  54,  50,  55,  45,  52,  93,  56,  57,  58,
+    } },
+  { "noise", 1, 90, DECODE_FAILED, 0, { 0x00, 0x00, 0x00, 0x00 }, 0, 0,
+    {
+       31, 255, 226, 107,  92,  48,  35,  56,  99, 143, 235,  62, 246,  72, 186, 176,
+      108, 230, 127,  32, 142,  67, 187, 208,  87, 159, 199,  52, 149,  27, 244, 176,
+       98, 203, 219,  88,  61,  95, 230, 237,  50, 247, 179, 133, 190,  32, 136, 242,
+      108, 213, 161, 116,  86, 118, 188, 229, 232, 250, 164, 232, 246,  83, 217, 144,
+       28,  23, 196,  87,  86, 136, 238, 106, 173, 243,  88, 161,  86, 224,  41,  48,
+       24, 221, 178, 223, 182,  44, 221,  91,  51, 223,
+    } },
+};
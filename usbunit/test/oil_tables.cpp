@@ -0,0 +1,249 @@
+/*
+ * oil_tables.cpp
+ *
+ * Generator of the oil sensor conversion tables in oil_sensor.ino.
+ *
+ *   oil_tables        print the tables of both boards
+ *   oil_tables -c     compare them with ../oil_sensor.ino and print the
+ *                     max. interpolation error of the temperature table
+ *
+ * The sensor curves and board parameters are the ones documented above
+ * the tables in oil_sensor.ino, change both together.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLE_SIZE   65
+#define TABLE_BITS   6
+
+/* Temperature sensor, NTC */
+#define T0_C         40.0
+#define R0_OHM       5830.0
+#define T1_C         150.0
+#define R1_OHM       316.0
+#define RV_OHM       1000.0
+#define T_MIN_C      -40.0
+#define T_MAX_C      200.0
+
+/* Pressure sensor, 0.5V = 0 bar, 4.5V = 10 bar */
+#define P_BOARD_V    5.0
+#define P_V_PER_BAR  0.4
+#define P_OFFSET_BAR 1.25
+
+#define KELVIN       273.15
+
+typedef struct board_t {
+  const char *name;
+  int maxcode;
+  int pmin;
+  int pmax;
+  int adc_bits;
+  int raw_bits;      // OIL_RAW_BITS
+} board_t;
+
+/* Same order as in oil_sensor.ino */
+static const board_t boards[] = {
+  { "REDBEAR_DUO",     4095, 410, 3689, 12, 12 },
+  { "ARDUINO_GENERIC", 1023, 102,  922, 10, 14 },
+};
+
+#define NUM_BOARDS   (sizeof(boards) / sizeof(boards[0]))
+
+/* Round half to even like the original generator */
+static int round_value( double v)
+{
+  return (int)nearbyint( v);
+}
+
+/* Temperature in C at ADC 'code' */
+static double temp_c( const board_t *b, double code)
+{
+  double t0 = T0_C + KELVIN;
+  double t1 = T1_C + KELVIN;
+  double beta = t0 * t1 / (t1 - t0) * log( R0_OHM / R1_OHM);
+  double x, rn, t;
+
+  if( code <= 0) {
+    return T_MIN_C;
+  }
+  if( code >= b->maxcode) {
+    return T_MAX_C;
+  }
+
+  x = code / b->maxcode;
+  rn = RV_OHM * (1 - x) / x;
+  t = t0 * beta / (beta + t0 * log( rn / R0_OHM)) - KELVIN;
+
+  return t < T_MIN_C ? T_MIN_C : t > T_MAX_C ? T_MAX_C : t;
+}
+
+/* Pressure in bar at ADC 'code' */
+static double press_bar( const board_t *b, double code)
+{
+  if( code < b->pmin) {
+    code = b->pmin;
+  }
+  if( code > b->pmax) {
+    code = b->pmax;
+  }
+
+  return code * P_BOARD_V / (b->maxcode * P_V_PER_BAR) - P_OFFSET_BAR;
+}
+
+static void make_tables( const board_t *b, int temp[], int press[])
+{
+  for( int i = 0; i < TABLE_SIZE; i++) {
+    double code = (double)i * (b->maxcode + 1) / (TABLE_SIZE - 1);
+
+    temp[i] = round_value( temp_c( b, code) * 10);
+    press[i] = round_value( press_bar( b, code) * 100);
+  }
+}
+
+static void print_table( const char *name, const int table[])
+{
+  printf( "const int16_t %s[OIL_TABLE_SIZE] PROGMEM = {\n", name);
+  for( int i = 0; i < TABLE_SIZE; i++) {
+    printf( "%s%6d%s", (i % 8 == 0) ? " " : "", table[i],
+            (i == TABLE_SIZE - 1) ? "\n" : (i % 8 == 7) ? ",\n" : ",");
+  }
+  printf( "};\n");
+}
+
+/*
+ * Read the next table 'name' after 'pos' from the sketch source.
+ * Returns the position after the table or NULL.
+ */
+static const char *read_table( const char *pos, const char *name, int table[])
+{
+  char key[80];
+  char *end;
+
+  snprintf( key, sizeof(key), "%s[OIL_TABLE_SIZE] PROGMEM = {", name);
+  pos = strstr( pos, key);
+  if( pos == NULL) {
+    return NULL;
+  }
+  pos += strlen( key);
+
+  for( int i = 0; i < TABLE_SIZE; i++) {
+    table[i] = strtol( pos, &end, 10);
+    if( end == pos) {
+      return NULL;
+    }
+    pos = end;
+    while( *pos == ',' || *pos == ' ' || *pos == '\n') {
+      pos++;
+    }
+  }
+
+  return pos;
+}
+
+static int compare( const char *board, const char *name, const int expect[], const int table[])
+{
+  int diffs = 0;
+
+  for( int i = 0; i < TABLE_SIZE; i++) {
+    if( expect[i] != table[i]) {
+      printf( "%s %s[%d] = %d, generated %d\n", board, name, i, table[i], expect[i]);
+      diffs++;
+    }
+  }
+
+  return diffs;
+}
+
+/*
+ * Max. error of the interpolation in oil_interpolate() against the
+ * equation, in the bands documented in oil_sensor.ino.
+ */
+static void print_temp_error( const board_t *b, const int table[])
+{
+  static const double band[] = { T_MIN_C, 0, 40, 160, T_MAX_C };
+  double err[4] = { 0, 0, 0, 0 };
+  int shift = b->raw_bits - TABLE_BITS;
+
+  for( long raw = 0; raw < (1L << b->raw_bits) - (1L << shift); raw++) {
+    int idx = raw >> shift;
+    long frac = raw & ((1L << shift) - 1);
+    int value = table[idx] + (int)(((long)(table[idx + 1] - table[idx]) * frac) >> shift);
+    double t = temp_c( b, (double)raw / (1L << (b->raw_bits - b->adc_bits)));
+
+    for( int i = 0; i < 4; i++) {
+      if( t >= band[i] && t < band[i + 1] && fabs( value / 10.0 - t) > err[i]) {
+        err[i] = fabs( value / 10.0 - t);
+      }
+    }
+  }
+
+  printf( "%s max. error: %.1f C below 0 C, %.1f C 0..40 C, %.1f C 40..160 C, %.1f C 160..200 C\n",
+          b->name, err[0], err[1], err[2], err[3]);
+}
+
+static int check( void)
+{
+  static char src[200000];
+  const char *pos = src;
+  int temp[TABLE_SIZE], press[TABLE_SIZE];
+  int table[TABLE_SIZE];
+  int diffs = 0;
+  size_t len;
+  FILE *f;
+
+  f = fopen( "../oil_sensor.ino", "r");
+  if( f == NULL) {
+    perror( "../oil_sensor.ino");
+    return 1;
+  }
+  len = fread( src, 1, sizeof(src) - 1, f);
+  src[len] = '\0';
+  fclose( f);
+
+  for( unsigned int n = 0; n < NUM_BOARDS; n++) {
+    make_tables( &boards[n], temp, press);
+
+    pos = read_table( pos, "oil_temp_table", table);
+    if( pos == NULL) {
+      printf( "%s oil_temp_table not found\n", boards[n].name);
+      return 1;
+    }
+    diffs += compare( boards[n].name, "oil_temp_table", temp, table);
+    print_temp_error( &boards[n], table);
+
+    pos = read_table( pos, "oil_press_table", table);
+    if( pos == NULL) {
+      printf( "%s oil_press_table not found\n", boards[n].name);
+      return 1;
+    }
+    diffs += compare( boards[n].name, "oil_press_table", press, table);
+  }
+
+  printf( "table differences %d\n", diffs);
+
+  return diffs == 0 ? 0 : 1;
+}
+
+int main( int argc, char *argv[])
+{
+  int temp[TABLE_SIZE], press[TABLE_SIZE];
+
+  if( argc > 1 && strcmp( argv[1], "-c") == 0) {
+    return check();
+  }
+
+  for( unsigned int n = 0; n < NUM_BOARDS; n++) {
+    make_tables( &boards[n], temp, press);
+
+    printf( "#ifdef %s\n", boards[n].name);
+    print_table( "oil_temp_table", temp);
+    printf( "\n");
+    print_table( "oil_press_table", press);
+    printf( "#endif\n\n");
+  }
+
+  return 0;
+}
@@ -13,13 +13,40 @@
 /* Reserved space for our sensors */
 #define TPMS_433_NUM_SENSORS    4
 /* We keep some extra space for sensors that are not ours */
-#define TPMS_433_EXTRA_SENSORS  8
+#define TPMS_433_EXTRA_SENSORS  10
 
-#define TPMS_433_ID_LENGTH      4 // in bytes
+#define TPMS_433_SLOTS          (TPMS_433_NUM_SENSORS + TPMS_433_EXTRA_SENSORS)
+
+/* Hash index on the sensor ID, must be a power of 2 */
+#define TPMS_433_HASH_SIZE       8
+#define TPMS_433_NO_SLOT      0xff
+
+#define TPMS_433_ID_LENGTH      TPMS_ID_LENGTH // in bytes
 
 #define TPMS_433_SCORE_MAX       250
 #define TPMS_433_SCORE_ADD        10
-#define TPMS_433_SCORE_TIMEOUT_s  20
+#define TPMS_433_SCORE_TIMEOUT_s  20   // score decays by 1 per timeout
+
+/* Sensors repeat every reading in several bursts.
+ * Identical readings within this window are counted as duplicates only.
+ */
+#define TPMS_433_DUP_WINDOW_msec  2000
+#define TPMS_433_DUP_ENTRIES         4
+
+/* Learn mode, started with usbget -s TPMS -p LEARN=1
+ * A sensor qualifies after TPMS_433_LEARN_FRAMES consistent readings.
+ */
+#define TPMS_433_LEARN_FRAMES        4
+#define TPMS_433_LEARN_TIMEOUT_s   900
+#define TPMS_433_LEARN_MIN_cbar    TPMS_MIN_PRESS_cbar
+#define TPMS_433_LEARN_MAX_cbar    TPMS_MAX_PRESS_cbar
+#define TPMS_433_LEARN_DELTA_cbar   10   // max change between two readings
+#define TPMS_433_LEARN_MIN_dBm     -90   // our own sensors are close by
+
+#define TPMS_433_LEARN_OFF           0
+#define TPMS_433_LEARN_ACTIVE        1
+#define TPMS_433_LEARN_LOCKED        2
+#define TPMS_433_LEARN_TIMEOUT       3
 
 /*
  * Configuration structure stored in EEPROM.
@@ -33,16 +60,54 @@ typedef struct tpms433_config_t {
   
 } tpms433_config_t;
 
+/*
+ * Sensor slot, 12 bytes.
+ * Sensors never move in memory, the score order is kept in Tpms433::order[].
+ */
 typedef struct tpms433_sensor_t {
 
   byte sensorId[TPMS_433_ID_LENGTH];
   unsigned long last_update;
-  float press_bar;
-  float temp_c;
-  byte score;
+  uint16_t press_cbar;        // pressure in 1/100 bar
+  int8_t temp_c;
+  byte score;                 // score at last_update
   
 } tpms433_sensor_t;
 
+/*
+ * Link statistics per sensor slot, kept next to sensor[].
+ * Frames include repeated bursts. A frame counts as error if its
+ * checksum was only ok after error correction, frames that stay
+ * broken cannot be assigned to a sensor.
+ */
+typedef struct tpms433_link_t {
+
+  unsigned long first;        // millis() of the first frame
+  uint16_t frames;
+  uint16_t errors;
+  int16_t rssi_avg;           // running average in 1/16 dBm
+  int8_t rssi_min;            // dBm, 0 = no RSSI sample yet
+#ifdef CC1101_PACKET_SUPPORT
+  byte lqi;                   // of the last frame, packet mode only
+#endif
+
+} tpms433_link_t;
+
+#define TPMS_433_RSSI_AVG_SHIFT   3     // average over ~8 frames
+#define TPMS_433_RATE_MIN_s      60     // shortest time for frames/min
+
+/*
+ * Recently accepted reading for duplicate detection.
+ * Time is millis() when the reading was accepted.
+ */
+typedef struct tpms433_recent_t {
+
+  uint16_t hash;
+  bool used;
+  unsigned long time;
+
+} tpms433_recent_t;
+
 /*
  * This modules configuration data.
  */
@@ -55,8 +120,18 @@ class Tpms433 : public Action {
 
   private:
     unsigned int configLocation;
-    unsigned long next_score_adj;
-    tpms433_sensor_t sensor[TPMS_433_NUM_SENSORS + TPMS_433_EXTRA_SENSORS];
+    unsigned long order_changed;
+    tpms433_sensor_t sensor[TPMS_433_SLOTS];
+    byte order[TPMS_433_SLOTS];             // slots sorted by score
+    byte hash_head[TPMS_433_HASH_SIZE];     // first slot per hash bucket
+    byte hash_next[TPMS_433_SLOTS];         // next slot in same bucket
+    tpms433_link_t link[TPMS_433_SLOTS];
+    byte learn_frames[TPMS_433_SLOTS];      // readings since learn start
+    byte learn_bad[TPMS_433_SLOTS];         // inconsistent readings
+    byte learn_state;
+    unsigned long learn_start;
+    tpms433_recent_t recent[TPMS_433_DUP_ENTRIES];
+    byte recent_idx;
     
   public:
     size_t setup(unsigned int settingsLocation);
@@ -69,19 +144,57 @@ class Tpms433 : public Action {
 
     static void id2hex( byte b[], char hex[]);
     static void hex2id( char hex[], byte b[]);
-    tpms433_sensor_t* getSensors();
+    tpms433_sensor_t* getSensor( byte pos);
+    tpms433_link_t* getLink( byte pos);
+    unsigned int getFrameRate( byte pos);
+    byte getErrorRatio( byte pos);
+    unsigned long getOrderChanged();
     
   private:
-    int find_sensor( byteArray_t *data);
-    bool match_id( byte id, byteArray_t *data);
-    bool is_empty( byte id);
+    void process_reading( byte result, tpmsReading_t *reading, byte channel, byte rssi, byte lqi, unsigned long now);
+    void update_link( byte slot, byte result, byte rssi, byte lqi, unsigned long now);
+    int find_sensor( tpmsReading_t *reading, unsigned long now);
+    byte get_score( byte slot, unsigned long now);
+    unsigned int evict_key( byte slot, unsigned long now);
+    bool known_sensor( tpmsReading_t *reading);
+    byte lookup_slot( byte sensorId[]);
+    void hash_insert( byte slot);
+    void hash_remove( byte slot);
+    uint16_t reading_hash( tpmsReading_t *reading);
+    bool is_duplicate( uint16_t hash, unsigned long now);
+    void remember_reading( uint16_t hash, unsigned long now);
+    bool is_empty( byte slot);
     bool empty_config();
-    void force_update();
-    void copy_sensor( tpms433_sensor_t *t, tpms433_sensor_t *s);
     void set_sensor_IDs_from_config();
-    void sort_sensors( byte top);
+    void sort_sensors( unsigned long now);
+    void set_pulse_thresholds();
+    void set_carrier_sense();
+    void set_channels();
+    void send_carrier_sense();
+    void start_learning();
+    void learn_reading( byte slot, tpmsReading_t *reading, byte rssi);
+    int learn_value( byte slot);
+    void check_learning();
+    void send_learn_status();
+    void send_link( byte pos);
 };
 
+/*
+ * Hash bucket of a sensor ID.
+ */
+static inline byte id_hash( byte sensorId[])
+{
+  return (sensorId[0] ^ sensorId[1] ^ sensorId[2] ^ sensorId[3]) & (TPMS_433_HASH_SIZE - 1);
+}
+
+/*
+ * Empty slots have sensor ID 0x00000000
+ */
+static inline bool id_is_empty( byte sensorId[])
+{
+  return (sensorId[0] | sensorId[1] | sensorId[2] | sensorId[3]) == 0;
+}
+
 Tpms433 tpmsReceiver;
 
 #endif
@@ -16,6 +16,17 @@
  * Set config: Yes
  *   set smac for all sensors
  *     Keys: FL, FR, RL, RR
+ *   start learn mode, the first 4 sensors found are saved in EEPROM
+ *     Key:  LEARN=1 (LEARN=0 stops learning)
+ *   set pulse thresholds in usec (not saved in EEPROM)
+ *     Keys: TS (min short pulse), TL (min long pulse, disables adaption)
+ *     Key:  TA=1 enables adaptive long pulse threshold
+ *   set carrier sense level (not saved in EEPROM)
+ *     Key:  CS (0-7, disables adaption), CA=1 enables adaption
+ *   set channels to scan (not saved in EEPROM)
+ *     Key:  CH (bit mask, bit n = channel n)
+ *   use the CC1101 packet handler (CC1101_PACKET_SUPPORT, not saved in EEPROM)
+ *     Key:  PM=1 (PM=0 back to edge decoding)
  */
 
 #ifdef TPMS_433_SUPPORT
@@ -49,7 +60,10 @@ size_t Tpms433::setup(unsigned int eepromLocation)
     EEPROM.put( eepromLocation, tpms433Config);
   }
 
-  next_score_adj = millis() + 1000 * TPMS_433_SCORE_TIMEOUT_s;
+  memset( (void*)recent, 0, sizeof(recent));
+  recent_idx = 0;
+
+  learn_state = TPMS_433_LEARN_OFF;
 
   /* Clear sensor array */
   set_sensor_IDs_from_config();
@@ -67,57 +81,190 @@ size_t Tpms433::setup(unsigned int eepromLocation)
 void Tpms433::timeout()
 {
   unsigned long now = millis();
-  byteArray_t data;
-  byte id;
-  byte i;
+  rxFrame_t *frame;
+  tpmsReading_t reading;
+  byte result;
+  byte frames = 0;
+  byte packets = 0;
+  byte channel;
+  byte rssi;
+#ifdef CC1101_PACKET_SUPPORT
+  byte packet[CC1101_PACKET_LEN];
+  byte lqi;
+#endif
 
-  /* Lower score of all sensors periodically */
-  if( now > next_score_adj) {
-    next_score_adj = now + 1000 * TPMS_433_SCORE_TIMEOUT_s;
+  while( (frame = next_frame()) != NULL)
+  {
+    frames++;
+    result = decode_tpms( frame, &reading);
+    channel = frame->channel;
+    rssi = frame->rssi;
 
-    for( id = 0; id < TPMS_433_NUM_SENSORS + TPMS_433_EXTRA_SENSORS; id++) {
-      if( sensor[id].score > 0) {
-        sensor[id].score--;
-      }
+    /* We can release the frame here because the pulse buffer
+     * is not used anymore.
+     */
+    release_frame();
+
+    process_reading( result, &reading, channel, rssi, 0, now);
+  }
+
+#ifdef CC1101_PACKET_SUPPORT
+  while( receiver.readPacket( packet, &rssi, &lqi)) {
+    packets++;
+    result = decode_tpms_packet( packet, CC1101_PACKET_LEN, &reading);
+    process_reading( result, &reading, receiver.getChannel(), rssi, lqi & 0x7f, now);
+  }
+#endif
+
+  if( frames > 0) {
+    /* New pulses are in the histogram, follow the sensor clock */
+    adapt_pulse_thresholds();
+  }
+
+  if( learn_state == TPMS_433_LEARN_ACTIVE) {
+    /* Also time out if no frames arrive at all */
+    if( now - learn_start > 1000UL * TPMS_433_LEARN_TIMEOUT_s) {
+      learn_state = TPMS_433_LEARN_TIMEOUT;
+
+    } else if( frames + packets > 0) {
+      check_learning();
     }
   }
 
-  if ( receiver_state == STATE_DATA_AVAILABLE)
-  {
-    /* Returns true is decoding went fine and checksum was ok. */
+  if( !receiver.packetMode) {
+    count_masked_edges();
+  }
 
-    if( decode_tpms( timings, timings_count, first_edge_state, &data)) {
+  receiver.adaptCarrierSense();
+  receiver.scanChannels();
+}
 
-      /* We can enable receiver state here because the timings buffer
-       * is not used anymore.
-       */
-      init_receiver();
+/*
+ * Update the sensor table with a decoded reading.
+ * 'rssi' is the raw RSSI status byte, 'lqi' is 0 in edge mode.
+ */
+void Tpms433::process_reading( byte result, tpmsReading_t *reading, byte channel, byte rssi, byte lqi, unsigned long now)
+{
+  uint16_t hash;
+  int id;
+  byte slot;
+  byte score;
+  byte pos;
 
-      id = find_sensor( &data);
-      
-      /* find_sensor may return -1 if there are no extra slots available */
-      if( id >= 0) {
-        sensor[id].press_bar = (float)data.bytes[5] * 1.38 / 100; //pressure in bar
-        sensor[id].temp_c    = (float)data.bytes[6] - 50;
-        /*
-         * The last_update timestamp is used by the display to determine 
-         * whether or not to update the display for that particular sensor.
-         */
-        sensor[id].last_update = now;
+  if( result == DECODE_FAILED) {
+    return;
+  }
 
-        if( sensor[id].score >= TPMS_433_SCORE_MAX - TPMS_433_SCORE_ADD) {
-          sensor[id].score = TPMS_433_SCORE_MAX;
-        } else {
-          sensor[id].score += TPMS_433_SCORE_ADD;
-        }
+  /* Repeated burst of a reading we already processed */
+  hash = reading_hash( reading);
+  if( is_duplicate( hash, now)) {
+    statistics.duplicates++;
 
-        /* We need to sort only after new data was inserted */
-        sort_sensors( id);
-      }
+    /* Still a frame received from the sensor */
+    slot = lookup_slot( reading->id);
+    if( slot != TPMS_433_NO_SLOT) {
+      update_link( slot, result, rssi, lqi, now);
+    }
+    return;
+  }
+
+  if( result == DECODE_RECOVERED) {
+    /* Error correction may produce a wrong frame that passes the
+     * XOR checksum. Only accept it for sensors we already know.
+     */
+    if( !known_sensor( reading)) {
+      statistics.checksum_fails++;
+      return;
+    }
+    statistics.checksum_recovered++;
+
+  } else if( (protocol_flags( reading->protocol) & PROTO_KNOWN_ONLY) && !known_sensor( reading)) {
+    /* Weak checksum, may be a corrupted frame of another protocol */
+    return;
+  }
+
+  remember_reading( hash, now);
+
+  id = find_sensor( reading, now);
+
+  /* find_sensor may return -1 if there are no extra slots available */
+  if( id < 0) {
+    return;
+  }
+
+  update_link( id, result, rssi, lqi, now);
+
+  if( learn_state == TPMS_433_LEARN_ACTIVE) {
+    learn_reading( id, reading, rssi);
+  }
+
+  sensor[id].press_cbar = reading->press_cbar;
+  sensor[id].temp_c     = constrain( reading->temp_c, -128, 127);
+
+  /* Fold the decay since the last reception into the stored score */
+  score = get_score( id, now);
+
+  if( score >= TPMS_433_SCORE_MAX - TPMS_433_SCORE_ADD) {
+    sensor[id].score = TPMS_433_SCORE_MAX;
+  } else {
+    sensor[id].score = score + TPMS_433_SCORE_ADD;
+  }
+
+  /*
+   * The last_update timestamp is used by the display to determine 
+   * whether or not to update the display for that particular sensor.
+   * It is also the reference time of the score decay.
+   */
+  sensor[id].last_update = now;
+
+  /* We need to sort only after new data was inserted */
+  sort_sensors( now);
+
+  /* Only our own sensors keep the channel scanner on a channel */
+  for( pos = 0; pos < TPMS_433_NUM_SENSORS; pos++) {
+    if( order[pos] == id) {
+      receiver.channelHit( channel);
+      break;
+    }
+  }
+}
+
+/*
+ * Account a frame in the link statistics of a slot.
+ */
+void Tpms433::update_link( byte slot, byte result, byte rssi, byte lqi, unsigned long now)
+{
+  tpms433_link_t *l = &link[slot];
+  int dbm;
+
+  if( l->frames == 0) {
+    l->first = now;
+  }
+
+  if( l->frames < 0xffff) {
+    l->frames++;
+    if( result == DECODE_RECOVERED) {
+      l->errors++;
+    }
+  }
+
+  if( rssi != CC1101_RSSI_NONE) {
+    dbm = cc1101_rssi_dbm( rssi);
+
+    if( l->rssi_min == 0) {
+      l->rssi_avg = dbm * 16;
+      l->rssi_min = dbm;
     } else {
-      init_receiver();
+      l->rssi_avg += (dbm * 16 - l->rssi_avg) >> TPMS_433_RSSI_AVG_SHIFT;
+      if( dbm < l->rssi_min) {
+        l->rssi_min = dbm;
+      }
     }
   }
+
+#ifdef CC1101_PACKET_SUPPORT
+  l->lqi = lqi;
+#endif
 }
 
 /*
@@ -149,8 +296,8 @@ void Tpms433::getData()
      * Temperature: One digit right of the dot.
      */
     for( byte i = 0; i < TPMS_433_NUM_SENSORS; i++) {
-      sensor[i].press_bar = (180 + random(40)) / 100.0;
-      sensor[i].temp_c    = (-100 + random(900)) / 10.0;
+      getSensor( i)->press_cbar = 180 + random(40);
+      getSensor( i)->temp_c     = -10 + random(90);
       //sensor[i].lastupdated = millis();
     }
   }
@@ -181,16 +328,18 @@ void Tpms433::sendData()
   sendMoreDataStart();
   
   for( byte i = 0; i < TPMS_433_NUM_SENSORS; i++) {
-    id2hex( sensor[i].sensorId, hexstr );
+    tpms433_sensor_t *s = getSensor( i);
+
+    id2hex( s->sensorId, hexstr );
     hexstr[ 2 * TPMS_433_ID_LENGTH ] = '\0';
     
     Serial.print(i);
     Serial.print(F(": "));
     Serial.print(hexstr);
     Serial.print(F(" "));
-    Serial.print(sensor[i].temp_c,1);
+    Serial.print((float)s->temp_c,1);
     Serial.print(F(" "));
-    Serial.print(sensor[i].press_bar,2);
+    Serial.print(s->press_cbar / 100.0,2);
     Serial.print(F(" "));
 
   }
@@ -220,8 +369,14 @@ void Tpms433::sendConfig()
     sendMoreDataEnd();
   }
 
-  for( byte i = 0; i < TPMS_433_NUM_SENSORS + TPMS_433_EXTRA_SENSORS; i++) {
-    id2hex( sensor[i].sensorId, hexstr );
+  send_learn_status();
+  send_carrier_sense();
+  receiver.sendChannelStatistics();
+
+  for( byte i = 0; i < TPMS_433_SLOTS; i++) {
+    tpms433_sensor_t *s = getSensor( i);
+
+    id2hex( s->sensorId, hexstr );
     hexstr[ 2 * TPMS_433_ID_LENGTH ] = '\0';
     
     sendMoreDataStart();
@@ -229,15 +384,55 @@ void Tpms433::sendConfig()
     Serial.print(F(" ID="));
     Serial.print(hexstr);
     Serial.print(F(" T="));
-    Serial.print(sensor[i].temp_c,1);
+    Serial.print((float)s->temp_c,1);
     Serial.print(F(" P="));
-    Serial.print(sensor[i].press_bar,2);
+    Serial.print(s->press_cbar / 100.0,2);
     Serial.print(F(" S="));
-    Serial.print(sensor[i].score);
+    Serial.print(get_score( order[i], millis()));
+    if( learn_state == TPMS_433_LEARN_ACTIVE) {
+      Serial.print(F(" L="));
+      Serial.print(learn_value( order[i]));
+    }
+    send_link( i);
     sendMoreDataEnd();
   }
 }
 
+/*
+ * Append the link statistics to a sensor line.
+ *
+ * F=12 E=5 R=-67/-81
+ * F frames per minute, E percentage of corrected frames,
+ * R average/minimum RSSI in dBm, Q LQI of the last frame in packet mode.
+ */
+void Tpms433::send_link( byte pos)
+{
+  tpms433_link_t *l = getLink( pos);
+
+  if( l->frames == 0) {
+    return;
+  }
+
+  Serial.print(F(" F="));
+  Serial.print(getFrameRate( pos));
+  Serial.print(F(" E="));
+  Serial.print(getErrorRatio( pos));
+
+  if( l->rssi_min != 0) {
+    Serial.print(F(" R="));
+    Serial.print(l->rssi_avg / 16);
+    Serial.print(F("/"));
+    Serial.print(l->rssi_min);
+  }
+
+#ifdef CC1101_PACKET_SUPPORT
+  if( receiver.packetMode) {
+    Serial.print(F(" Q="));
+    Serial.print(l->lqi);
+  }
+#endif
+}
+
 /*
  * This function is called to set configuration values for this action.
  * The configuration is stored in EEPROM and survives a reboot.
@@ -279,11 +474,351 @@ void Tpms433::setConfig()
       EEPROM.put( configLocation, tpms433Config);
       set_sensor_IDs_from_config();
   }  
+
+  switch( getIntParam( "LEARN", -1)) {
+  case 0:
+    learn_state = TPMS_433_LEARN_OFF;
+    break;
+
+  case 1:
+    start_learning();
+    break;
+  }
+
+  set_pulse_thresholds();
+  set_carrier_sense();
+  set_channels();
+}
+
+/*
+ * Override pulse thresholds of the receiver.
+ *
+ * usbget -d <device> -s TPMS -p "TS=20;TL=80"
+ * usbget -d <device> -s TPMS -p "TA=1"
+ */
+void Tpms433::set_pulse_thresholds()
+{
+  int min_short = getIntParam( "TS", pulse_min_short_usec);
+  int min_long = getIntParam( "TL", -1);
+  bool fixed = (min_long >= 0);
+
+  if( !fixed) {
+    min_long = pulse_min_long_usec;
+  }
+
+  if( min_short < 1 || min_long <= min_short || min_long > 255) {
+    flagError( ERROR_INVALID_PARAM);
+    return;
+  }
+
+  if( fixed) {
+    pulse_adaptive = false;
+  }
+
+  if( getIntParam( "TA", 0) == 1) {
+    pulse_adaptive = true;
+  }
+
+  pulse_min_short_usec = min_short;
+  pulse_min_long_usec = min_long;
+}
+
+/*
+ * Set the carrier sense level of the receiver.
+ *
+ * usbget -d <device> -s TPMS -p "CS=4"
+ * usbget -d <device> -s TPMS -p "CA=1"
+ */
+void Tpms433::set_carrier_sense()
+{
+  int level = getIntParam( "CS", -1);
+
+  if( level >= 0) {
+    if( level >= CC1101_CS_LEVELS) {
+      flagError( ERROR_INVALID_PARAM);
+      return;
+    }
+    receiver.csAdaptive = false;
+    receiver.setCarrierSense( level);
+  }
+
+  if( getIntParam( "CA", 0) == 1) {
+    receiver.csAdaptive = true;
+  }
+
+#ifdef CC1101_PACKET_SUPPORT
+  int packet_mode = getIntParam( "PM", -1);
+
+  if( packet_mode >= 0) {
+    if( packet_mode > 1) {
+      flagError( ERROR_INVALID_PARAM);
+      return;
+    }
+    receiver.setPacketMode( packet_mode == 1);
+  }
+#endif
+}
+
+/*
+ * Select the channels the receiver scans, bit n = channel n.
+ *
+ * usbget -d <device> -s TPMS -p "CH=3"
+ */
+void Tpms433::set_channels()
+{
+  int channels = getIntParam( "CH", -1);
+
+  if( channels >= 0) {
+    if( channels == 0 || channels >= (1 << NUMBER_OF_FCHANNELS)) {
+      flagError( ERROR_INVALID_PARAM);
+      return;
+    }
+    receiver.setChannels( channels);
+  }
 }
 
-tpms433_sensor_t* Tpms433::getSensors() {
+/*
+ * Send the carrier sense level and register values.
+ *
+ * CS=2 auto AGC=C650
+ */
+void Tpms433::send_carrier_sense()
+{
+  byte agcctrl2, agcctrl1;
+
+  receiver.getCarrierSense( &agcctrl2, &agcctrl1);
+
+  sendMoreDataStart();
+  Serial.print(F("CS="));
+  Serial.print(receiver.csLevel);
+  Serial.print(receiver.csAdaptive ? F(" auto") : F(" fixed"));
+  Serial.print(F(" AGC="));
+  Serial.print(agcctrl2 >> 4, HEX);
+  Serial.print(agcctrl2 & 0x0f, HEX);
+  Serial.print(agcctrl1 >> 4, HEX);
+  Serial.print(agcctrl1 & 0x0f, HEX);
+  sendMoreDataEnd();
+
+#ifdef CC1101_PACKET_SUPPORT
+  sendMoreDataStart();
+  Serial.print(F("PM="));
+  Serial.print(receiver.packetMode ? F("packet") : F("edge"));
+  sendMoreDataEnd();
+#endif
+}
+
+/*
+ * Start learn mode.
+ *
+ * usbget -d <device> -s TPMS -p "LEARN=1"
+ *
+ * Every sensor collects readings from now on. Readings with a pressure
+ * outside of the plausible tire range or with a jump in pressure count
+ * as inconsistent. Our own sensors are received more often than the
+ * sensors of passing cars. As soon as 4 sensors have enough consistent
+ * readings and clearly stand out from the 5th, their IDs are saved.
+ */
+void Tpms433::start_learning()
+{
+  memset( (void*)learn_frames, 0, sizeof(learn_frames));
+  memset( (void*)learn_bad, 0, sizeof(learn_bad));
+
+  learn_start = millis();
+  learn_state = TPMS_433_LEARN_ACTIVE;
+}
+
+/*
+ * Count a reading of the sensor in 'slot' for learn mode.
+ * Must be called before the reading is stored in the slot.
+ */
+void Tpms433::learn_reading( byte slot, tpmsReading_t *reading, byte rssi)
+{
+  unsigned int press = reading->press_cbar;
+  unsigned int last = sensor[slot].press_cbar;
+
+  if(    press < TPMS_433_LEARN_MIN_cbar || press > TPMS_433_LEARN_MAX_cbar
+      || (rssi != CC1101_RSSI_NONE && cc1101_rssi_dbm( rssi) < TPMS_433_LEARN_MIN_dBm)
+      || (learn_frames[slot] > 0
+          && (press > last + TPMS_433_LEARN_DELTA_cbar || last > press + TPMS_433_LEARN_DELTA_cbar))) {
+    if( learn_bad[slot] < 255) learn_bad[slot]++;
+  }
+
+  if( learn_frames[slot] < 255) learn_frames[slot]++;
+}
+
+/*
+ * Learn value of a sensor: consistent readings minus a penalty for
+ * inconsistent ones.
+ */
+int Tpms433::learn_value( byte slot)
+{
+  return (int)learn_frames[slot] - 2 * (int)learn_bad[slot];
+}
+
+/*
+ * Check whether our 4 sensors are known and save them.
+ */
+void Tpms433::check_learning()
+{
+  byte best[TPMS_433_NUM_SENSORS + 1];
+  int value[TPMS_433_NUM_SENSORS + 1];
+  byte slot;
+  byte i;
+  byte n = 0;
+  int v;
+
+  /* Find the 5 best candidates, sorted by learn value */
+  for( slot = 0; slot < TPMS_433_SLOTS; slot++) {
+    v = learn_value( slot);
+    if( is_empty( slot) || v <= 0) {
+      continue;
+    }
+
+    for( i = n; i > 0 && value[i-1] < v; i--) {
+      if( i < TPMS_433_NUM_SENSORS + 1) {
+        best[i] = best[i-1];
+        value[i] = value[i-1];
+      }
+    }
+
+    if( i < TPMS_433_NUM_SENSORS + 1) {
+      best[i] = slot;
+      value[i] = v;
+      if( n < TPMS_433_NUM_SENSORS + 1) n++;
+    }
+  }
+
+  if(    n < TPMS_433_NUM_SENSORS
+      || value[TPMS_433_NUM_SENSORS - 1] < TPMS_433_LEARN_FRAMES
+      || (n > TPMS_433_NUM_SENSORS && 2 * value[TPMS_433_NUM_SENSORS] > value[TPMS_433_NUM_SENSORS - 1])) {
+    return;
+  }
+
+  for( i = 0; i < TPMS_433_NUM_SENSORS; i++) {
+    memcpy( tpms433Config.sensorId[i], sensor[ best[i]].sensorId, TPMS_433_ID_LENGTH);
+  }
+
+  tpms433Config.checksum = computeChecksum( &tpms433Config, sizeof(tpms433Config));
+  EEPROM.put( configLocation, tpms433Config);
+  set_sensor_IDs_from_config();
+
+  learn_state = TPMS_433_LEARN_LOCKED;
+}
+
+/*
+ * Send learn mode state and the number of sensors that qualify.
+ *
+ * LEARN=active 2/4 T=35
+ */
+void Tpms433::send_learn_status()
+{
+  byte found = 0;
+
+  for( byte slot = 0; slot < TPMS_433_SLOTS; slot++) {
+    if( !is_empty( slot) && learn_value( slot) >= TPMS_433_LEARN_FRAMES) {
+      found++;
+    }
+  }
+
+  sendMoreDataStart();
+  Serial.print(F("LEARN="));
+
+  switch( learn_state) {
+  case TPMS_433_LEARN_OFF:
+    Serial.print(F("off"));
+    break;
+
+  case TPMS_433_LEARN_ACTIVE:
+    Serial.print(F("active "));
+    Serial.print(found);
+    Serial.print(F("/"));
+    Serial.print(TPMS_433_NUM_SENSORS);
+    Serial.print(F(" T="));
+    Serial.print((millis() - learn_start) / 1000);
+    break;
+
+  case TPMS_433_LEARN_LOCKED:
+    Serial.print(F("locked"));
+    break;
+
+  case TPMS_433_LEARN_TIMEOUT:
+    Serial.print(F("timeout"));
+    break;
+  }
+  sendMoreDataEnd();
+}
+
+/*
+ * Return the sensor at position 'pos' in score order.
+ * Positions 0-3 are the sensors shown on the display.
+ */
+tpms433_sensor_t* Tpms433::getSensor( byte pos) {
   
-  return sensor;
+  return &sensor[ order[ pos]];
+}
+
+/*
+ * Time of the last change of the sensors at positions 0-3.
+ * The display redraws all sensors if the order has changed.
+ */
+unsigned long Tpms433::getOrderChanged() {
+
+  return order_changed;
+}
+
+/*
+ * Link statistics of the sensor at position 'pos'.
+ */
+tpms433_link_t* Tpms433::getLink( byte pos) {
+
+  return &link[ order[ pos]];
+}
+
+/*
+ * Frames per minute of the sensor at position 'pos'.
+ * The rate is computed over at least TPMS_433_RATE_MIN_s.
+ */
+unsigned int Tpms433::getFrameRate( byte pos) {
+
+  tpms433_link_t *l = getLink( pos);
+  unsigned long secs = (millis() - l->first) / 1000;
+
+  if( secs < TPMS_433_RATE_MIN_s) {
+    secs = TPMS_433_RATE_MIN_s;
+  }
+
+  return (unsigned long)l->frames * 60 / secs;
+}
+
+/*
+ * Percentage of frames that needed error correction.
+ */
+byte Tpms433::getErrorRatio( byte pos) {
+
+  tpms433_link_t *l = getLink( pos);
+
+  if( l->frames == 0) {
+    return 0;
+  }
+
+  return (unsigned long)l->errors * 100 / l->frames;
+}
+
+/*
+ * Score of a sensor at time 'now'.
+ *
+ * The stored score is valid at last_update and loses one point every
+ * TPMS_433_SCORE_TIMEOUT_s after that. The difference is wrap safe.
+ */
+byte Tpms433::get_score( byte slot, unsigned long now)
+{
+  unsigned long decay = (now - sensor[slot].last_update) / (1000UL * TPMS_433_SCORE_TIMEOUT_s);
+
+  if( decay >= sensor[slot].score) {
+    return 0;
+  }
+
+  return sensor[slot].score - decay;
 }
 
 /* ***************** PRIVATE ******************* */
@@ -333,88 +868,196 @@ void static Tpms433::hex2id( char hex[], byte b[]) {
 }
 
 /* 
- *  Find a sensor that matched id in 'data'
+ *  Find a sensor that matched id in 'reading'
  *  
  *  First try to find a slot with the same sensor ID.
  *  If none was found, try to find an empty slot.
  *  If that fails as well, replace the last sensor.
+ *
+ *  Returns the slot number in sensor[].
  */
-int Tpms433::find_sensor( byteArray_t *data)
+int Tpms433::find_sensor( tpmsReading_t *reading, unsigned long now)
 {
-  byte id;
+  byte slot;
+  byte pos;
+  unsigned int key;
+  unsigned int min_key;
 
   /* First check whether we have seen this sensors before */
-  for( id = 0; id < TPMS_433_NUM_SENSORS + TPMS_433_EXTRA_SENSORS; id++) {
-    if( match_id( id, data)) {
-      return id;
-    }
+  slot = lookup_slot( reading->id);
+  if( slot != TPMS_433_NO_SLOT) {
+    return slot;
   }
   
-  if( TPMS_433_EXTRA_SENSORS > 0) {
+  /* An all zero ID marks an empty slot */
+  if( TPMS_433_EXTRA_SENSORS == 0 || id_is_empty( reading->id)) {
+    return -1;
+  }
+
+  /* Check for empty slot */
+  for( pos = 0; pos < TPMS_433_SLOTS; pos++) {
+    if( is_empty( order[pos])) {
+      break;
+    }
+  }
 
-    /* Check for empty slot */
-    for( id = 0; id < TPMS_433_NUM_SENSORS + TPMS_433_EXTRA_SENSORS; id++) {
-      if( is_empty( id)) {
+  if( pos < TPMS_433_SLOTS) {
+    slot = order[pos];
 
-        /* Copy sensor id */
-        for( byte i = 0; i < TPMS_433_ID_LENGTH; i++) {
-          sensor[id].sensorId[i] = data->bytes[i];
-        }
+  } else { /* Replace the sensor with the lowest score */
+    slot = order[ TPMS_433_SLOTS -1];
+    min_key = evict_key( slot, now);
 
-        return id;
+    for( pos = TPMS_433_SLOTS -1; pos > (empty_config() ? 0 : TPMS_433_NUM_SENSORS); pos--) {
+      key = evict_key( order[pos-1], now);
+      if( key < min_key) {
+        min_key = key;
+        slot = order[pos-1];
       }
     }
+
+    hash_remove( slot);
   }
 
-  if( TPMS_433_EXTRA_SENSORS == 0) {
-    return -1;
-    
-  } else { /* Replace last sensor */
-    id = TPMS_433_NUM_SENSORS + TPMS_433_EXTRA_SENSORS -1;
+  /* Clear sensor data */
+  memset( (void*)&sensor[slot], 0, sizeof(tpms433_sensor_t));
+  memset( (void*)&link[slot], 0, sizeof(tpms433_link_t));
+  learn_frames[slot] = 0;
+  learn_bad[slot] = 0;
 
-    /* Clear sensor data */
-    memset( (void*)&sensor[id], 0, sizeof(tpms433_sensor_t));
+  /* Copy sensor id */
+  memcpy( sensor[slot].sensorId, reading->id, TPMS_433_ID_LENGTH);
 
-    /* Copy sensor id */
-    for( byte i = 0; i < TPMS_433_ID_LENGTH; i++) {
-      sensor[id].sensorId[i] = data->bytes[i];
+  hash_insert( slot);
+
+  return slot;
+}
+
+/*
+ * Sensors with the lowest key are replaced first.
+ * In learn mode candidates must survive passing traffic, so the number
+ * of learned readings counts before the score.
+ */
+unsigned int Tpms433::evict_key( byte slot, unsigned long now)
+{
+  unsigned int key = get_score( slot, now);
+
+  if( learn_state == TPMS_433_LEARN_ACTIVE && learn_value( slot) > 0) {
+    key += learn_value( slot) * (TPMS_433_SCORE_MAX + 1);
+  }
+
+  return key;
+}
+
+/*
+ * Check if the sensor ID in 'reading' is configured or already in the sensor table.
+ */
+bool Tpms433::known_sensor( tpmsReading_t *reading)
+{
+  return lookup_slot( reading->id) != TPMS_433_NO_SLOT;
+}
+
+/*
+ * Find the slot of a sensor ID via the hash index.
+ */
+byte Tpms433::lookup_slot( byte sensorId[])
+{
+  byte slot = hash_head[ id_hash( sensorId)];
+
+  while( slot != TPMS_433_NO_SLOT) {
+    if( memcmp( sensor[slot].sensorId, sensorId, TPMS_433_ID_LENGTH) == 0) {
+      return slot;
     }
-    
-    return id;
+    slot = hash_next[slot];
   }
+
+  return TPMS_433_NO_SLOT;
 }
 
 /*
- * Check if a sensor matches id (first bytes in 'data')
+ * Add a slot to the hash index.
  */
-bool Tpms433::match_id( byte id, byteArray_t *data) 
+void Tpms433::hash_insert( byte slot)
 {
-  byte i;
+  byte h = id_hash( sensor[slot].sensorId);
+
+  hash_next[slot] = hash_head[h];
+  hash_head[h] = slot;
+}
+
+/*
+ * Remove a slot from the hash index.
+ */
+void Tpms433::hash_remove( byte slot)
+{
+  byte *p = &hash_head[ id_hash( sensor[slot].sensorId)];
 
-  for( i = 0; i < TPMS_433_ID_LENGTH; i++) {
-    if( sensor[id].sensorId[i] != get_byte( data, i)) {
-      return false;
+  while( *p != TPMS_433_NO_SLOT) {
+    if( *p == slot) {
+      *p = hash_next[slot];
+      return;
     }
+    p = &hash_next[*p];
   }
+}
 
-  return true;
+/*
+ * Short hash over all fields of a reading.
+ */
+uint16_t Tpms433::reading_hash( tpmsReading_t *reading)
+{
+  uint16_t hash = 0;
+  byte *p = (byte*)reading;
+
+  for( byte i = 0; i < sizeof(tpmsReading_t); i++) {
+    hash = ((hash << 5) | (hash >> 11)) ^ p[i];
+  }
+
+  return hash;
 }
 
-/* 
- * Check if a sensor slot is empty.
- * ID = 0x00000000
+/*
+ * Check if a reading with the same hash was accepted within the last
+ * TPMS_433_DUP_WINDOW_msec.
+ * Older entries are dropped, they never match again after millis() wrapped.
  */
-bool Tpms433::is_empty( byte id)
+bool Tpms433::is_duplicate( uint16_t hash, unsigned long now)
 {
-  byte i;
+  for( byte i = 0; i < TPMS_433_DUP_ENTRIES; i++) {
+    if( !recent[i].used) {
+      continue;
+    }
+
+    if( now - recent[i].time >= TPMS_433_DUP_WINDOW_msec) {
+      recent[i].used = false;
 
-  for( i = 0; i < TPMS_433_ID_LENGTH; i++) {
-    if( sensor[id].sensorId[i] != 0) {
-      return false;
+    } else if( recent[i].hash == hash) {
+      return true;
     }
   }
 
-  return true;  
+  return false;
+}
+
+/*
+ * Remember an accepted reading, replacing the oldest entry.
+ */
+void Tpms433::remember_reading( uint16_t hash, unsigned long now)
+{
+  recent[recent_idx].hash = hash;
+  recent[recent_idx].used = true;
+  recent[recent_idx].time = now;
+
+  recent_idx = (recent_idx + 1) % TPMS_433_DUP_ENTRIES;
+}
+
+/* 
+ * Check if a sensor slot is empty.
+ * ID = 0x00000000
+ */
+bool Tpms433::is_empty( byte slot)
+{
+  return id_is_empty( sensor[slot].sensorId);
 }
 
 /* 
@@ -433,57 +1076,48 @@ bool Tpms433::empty_config()
   return true;
 }
 
-/* 
- * Set last_update for all sensors to current time.
- * This forces a display update in the next cycle.
- */
-void Tpms433::force_update()
-{
-  unsigned long now = millis();
-
-  for( byte id = 0; id < TPMS_433_NUM_SENSORS; id++) {
-    sensor[id].last_update = now;
-  }
-}
-
-/*
- * Copy sensor s(ource) to t(arget)
- */
-void Tpms433::copy_sensor( tpms433_sensor_t *t, tpms433_sensor_t *s)
-{
-  memcpy( t, s, sizeof(tpms433_sensor_t));
-}
-
 /*
  * Clear all sensors and copy sensor IDs from EEPROM config.
  */
 void Tpms433::set_sensor_IDs_from_config()
 {
-  byte id;
+  byte slot;
   
-  for( id = 0; id < TPMS_433_NUM_SENSORS; id++) {
-
-    /* Clear sensor data */
-    memset( (void*)&sensor[id], 0, sizeof(tpms433_sensor_t));
+  /* Clear sensor data */
+  memset( (void*)sensor, 0, sizeof(sensor));
+  memset( (void*)link, 0, sizeof(link));
+  memset( (void*)hash_head, TPMS_433_NO_SLOT, sizeof(hash_head));
 
-    /* Copy sensor id */
-    for( byte i = 0; i < TPMS_433_ID_LENGTH; i++) {
-      sensor[id].sensorId[i] = tpms433Config.sensorId[id][i];
-    } 
+  for( slot = 0; slot < TPMS_433_SLOTS; slot++) {
+    order[slot] = slot;
   }
 
-  for( id = TPMS_433_NUM_SENSORS; id < TPMS_433_NUM_SENSORS + TPMS_433_EXTRA_SENSORS; id++) {
+  order_changed = millis();
 
-    /* Clear sensor data */
-    memset( (void*)&sensor[id], 0, sizeof(tpms433_sensor_t));
+  for( slot = 0; slot < TPMS_433_NUM_SENSORS; slot++) {
+
+    /* Copy sensor id */
+    memcpy( sensor[slot].sensorId, tpms433Config.sensorId[slot], TPMS_433_ID_LENGTH);
+
+    if( !is_empty( slot)) {
+      hash_insert( slot);
+    }
   }
 }
 
-void Tpms433::sort_sensors( byte bottom)
+/*
+ * Sort the sensors by their current score.
+ *
+ * Scores decay from the time of their last reception, so not only the
+ * updated sensor may change its position. The order is almost sorted
+ * already, insertion sort is fast on it.
+ */
+void Tpms433::sort_sensors( unsigned long now)
 {
-  tpms433_sensor_t temp;
-  byte id;
-  byte score;
+  byte score[TPMS_433_SLOTS];
+  byte slot;
+  byte pos;
+  byte i;
 
   /* Where to start sorting
    *  
@@ -491,34 +1125,26 @@ void Tpms433::sort_sensors( byte bottom)
    * There is not need to sort them, so we start after the configured sensors.
    */
   byte top = empty_config() ? 0 : TPMS_433_NUM_SENSORS;
-  byte pos = top;
-  
-  /* A new identified sensor always replaces the sensor with highest slot id.
-   * We simply need to move this sensor up to the right place.
-   */
-  score = sensor[bottom].score;
-  
-  for( id = bottom; id > top; id--) {
-    if( sensor[id-1].score > score) {
-      pos = id;
-      break; 
-    }
+
+  for( slot = 0; slot < TPMS_433_SLOTS; slot++) {
+    score[slot] = get_score( slot, now);
   }
 
-  if( pos < bottom) {
-    /* Move all sensors from pos to bottom down one slot. */
-    copy_sensor( &temp, &sensor[ bottom]);
+  for( i = top + 1; i < TPMS_433_SLOTS; i++) {
+    slot = order[i];
 
-    for( id = bottom; id > pos; id--) {
-      copy_sensor( &sensor[id], &sensor[id-1]);
+    for( pos = i; pos > top && score[ order[pos-1]] < score[slot]; pos--) {
+      order[pos] = order[pos-1];
     }
 
-    copy_sensor( &sensor[pos], &temp);
+    if( pos < i) {
+      order[pos] = slot;
 
-    if( pos < TPMS_433_NUM_SENSORS) {
-      /* The position of at least one of the sensors that are displayed has changed.
-       */
-      force_update();
+      if( pos < TPMS_433_NUM_SENSORS) {
+        /* The position of at least one of the sensors that are displayed has changed.
+         */
+        order_changed = now;
+      }
     }
   }
 }
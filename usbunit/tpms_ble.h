@@ -8,6 +8,13 @@
 #ifdef TPMS_BLE_SUPPORT
 
 #define TPMS_BLE_NUM_SENSORS 4
+#define TPMS_BLE_MAC_LENGTH  6
+
+/* Layout of the sensor advertisement data */
+#define TPMS_BLE_ADV_MAC     11   // sensor address, 6 bytes
+#define TPMS_BLE_ADV_PRESS   17   // pressure in Pa, 4 bytes little endian
+#define TPMS_BLE_ADV_TEMP    21   // temperature in 1/100 C, 4 bytes little endian
+#define TPMS_BLE_ADV_LENGTH  25
 
 #define FRONT_LEFT  0
 #define FRONT_RIGHT 1
@@ -27,6 +34,12 @@ typedef struct tpmsBLE_config_t {
  */
 tpmsBLE_config_t tpmsBLEConfig;
 
+/* tpmsBLEConfig.smac as binary, compared with the advertisement data */
+byte tpmsBLEMac[TPMS_BLE_NUM_SENSORS][TPMS_BLE_MAC_LENGTH];
+
+/* False if the smac of the slot could not be converted, the slot is not compared */
+bool tpmsBLEMacValid[TPMS_BLE_NUM_SENSORS];
+
 /* Tire pressure */
 volatile float tpmsPress[TPMS_BLE_NUM_SENSORS] = { 0.0, 0.0, 0.0, 0.0 };
 /* Tire temperature */
@@ -50,6 +63,7 @@ class TpmsBLE : public Action {
   private:
     boolean saveSMAC( const char *which, byte loc);
     boolean validSMAC( const char *smac);
+    static boolean smac2mac( const char *smac, byte mac[]);
 };
 
 #endif
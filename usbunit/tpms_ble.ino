@@ -51,6 +51,10 @@ size_t TpmsBLE::setup(unsigned int eepromLocation) {
     blinkLed( 200, 5);
   }
 
+  for( byte i = 0; i < TPMS_BLE_NUM_SENSORS; i++) {
+    tpmsBLEMacValid[i] = smac2mac( tpmsBLEConfig.smac[i], tpmsBLEMac[i]);
+  }
+
   ble.init();
   ble.onScanReportCallback(tpmsReportCallback);
   ble.setScanParams(BLE_SCAN_TYPE, BLE_SCAN_INTERVAL, BLE_SCAN_WINDOW);
@@ -145,6 +149,9 @@ boolean TpmsBLE::saveSMAC( const char *which, byte loc)
   if( param ) {
     if( validSMAC( param)) {
       strcpy( tpmsBLEConfig.smac[loc], param);
+      SINGLE_THREADED_BLOCK() {
+        tpmsBLEMacValid[loc] = smac2mac( param, tpmsBLEMac[loc]);
+      }
       return true;
     } else {
       flagError( ERROR_INVALID_PARAM);
@@ -156,59 +163,69 @@ boolean TpmsBLE::saveSMAC( const char *which, byte loc)
 
 boolean TpmsBLE::validSMAC( const char *smac) 
 {
+  byte mac[TPMS_BLE_MAC_LENGTH];
+
   return    (smac != NULL)
-         && (strlen( smac) == 12);
+         && (strlen( smac) == 2 * TPMS_BLE_MAC_LENGTH)
+         && smac2mac( smac, mac);
 }
 
-void tpmsReportCallback(advertisementReport_t *report)
-{  
-  char addr[16];
-  char val[10];
-  int pos = -1;
-
-  sprintf( addr, "%02X%02X%02X%02X%02X%02X",
-                 (unsigned char)report->advData[11],
-                 (unsigned char)report->advData[12],
-                 (unsigned char)report->advData[13],
-                 (unsigned char)report->advData[14],
-                 (unsigned char)report->advData[15],
-                 (unsigned char)report->advData[16]);
-
-  if( strcmp (tpmsBLEConfig.smac[FRONT_LEFT], addr) == 0) {
-    pos = FRONT_LEFT;
-  }
-  else if (strcmp (tpmsBLEConfig.smac[FRONT_RIGHT], addr) == 0) {
-    pos = FRONT_RIGHT;
-  }
-  else if (strcmp (tpmsBLEConfig.smac[REAR_LEFT], addr) == 0) {
-    pos = REAR_LEFT;
-  }
-  else if (strcmp (tpmsBLEConfig.smac[REAR_RIGHT], addr) == 0) {
-    pos = REAR_RIGHT;
+/*
+ * "80EACA100326" => { 0x80, 0xEA, 0xCA, 0x10, 0x03, 0x26 }
+ * False if smac contains other than hex digits.
+ */
+boolean TpmsBLE::smac2mac( const char *smac, byte mac[])
+{
+  char hex[3];
+
+  hex[2] = '\0';
+  for( byte i = 0; i < TPMS_BLE_MAC_LENGTH; i++) {
+    hex[0] = smac[2 * i];
+    hex[1] = smac[2 * i + 1];
+    if( !isxdigit( hex[0]) || !isxdigit( hex[1])) {
+      return false;
+    }
+    mac[i] = hex2int( hex);
   }
 
-  if( !actionSimulate) {
+  return true;
+}
+
+/* 4 bytes little endian */
+static inline uint32_t adv_uint32( const uint8_t *data)
+{
+  return    (uint32_t)data[0]
+         | ((uint32_t)data[1] << 8)
+         | ((uint32_t)data[2] << 16)
+         | ((uint32_t)data[3] << 24);
+}
 
-    if ((pos >= 0) && (pos <= 3)) {
-      sprintf( val, "%02X%02X%02X%02X",
-               (unsigned char)report->advData[20],
-               (unsigned char)report->advData[19],
-               (unsigned char)report->advData[18],
-               (unsigned char)report->advData[17]);
+/*
+ * Called by the BLE stack for every advertisement received.
+ * Advertisements of other devices are dropped after comparing the
+ * sensor address with the configured ones. Slots with an invalid
+ * smac in the EEPROM never match.
+ */
+void tpmsReportCallback(advertisementReport_t *report)
+{  
+  const uint8_t *data = report->advData;
+  int pos;
 
-      SINGLE_THREADED_BLOCK() {
-        tpmsPress[pos] = (float)hex2int(val)/100000.00;
-      }
-    
-      sprintf( val, "%02X%02X%02X%02X",
-               (unsigned char)report->advData[24],
-               (unsigned char)report->advData[23],
-               (unsigned char)report->advData[22],
-               (unsigned char)report->advData[21]);
+  if( report->advDataLen < TPMS_BLE_ADV_LENGTH) {
+    return;
+  }
 
-      SINGLE_THREADED_BLOCK() {
-        tpmsTemp[pos] = (float)hex2int(val)/100.00;
-      }
+  for( pos = 0; pos < TPMS_BLE_NUM_SENSORS; pos++) {
+    if(    tpmsBLEMacValid[pos]
+        && memcmp( &data[TPMS_BLE_ADV_MAC], tpmsBLEMac[pos], TPMS_BLE_MAC_LENGTH) == 0) {
+      break;
+    }
+  }
+
+  if( pos < TPMS_BLE_NUM_SENSORS && !actionSimulate) {
+    SINGLE_THREADED_BLOCK() {
+      tpmsPress[pos] = (float)adv_uint32( &data[TPMS_BLE_ADV_PRESS])/100000.00;
+      tpmsTemp[pos] = (float)(int32_t)adv_uint32( &data[TPMS_BLE_ADV_TEMP])/100.00;
     }
   }
 }
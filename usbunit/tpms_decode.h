@@ -1,6 +1,7 @@
 /*
- * Abarth 124 TPMS Sensor decoding
+ * TPMS Sensor decoding
  *
+ * Supported sensors are listed in tpms_protocol[].
  */
 
 /********************************************************/
@@ -38,21 +39,140 @@ typedef struct byteArray_t {
 
 /****************** PARAMETERS ***************************/
 
-#define MANCHESTER_DECODING_MASK  0b1010101010101010
+/* Manchester table entry: low nibble holds the decoded bits,
+ * high nibble flags the invalid bit pairs (00 or 11).
+ */
+#define MANCHESTER_BITS(e)     ((e) & 0x0f)
+#define MANCHESTER_INVALID(e)  ((e) & 0xf0)
 
 /* Pulse range in micro seconds */
 #define MIN_SHORT_usec   ((byte) 20)
 #define MIN_LONG_usec    ((byte) 80)
 
-/* Pulse type */
+/* Pulse type
+ * The receiver stores these as 2 bit codes, see PULSE_BITS in cc1101.h
+ */
 #define INVALID_PULSE ((byte)0)
 #define SHORT_PULSE   ((byte)1)
 #define LONG_PULSE    ((byte)2)
 
+/* Plausible temperature range in C */
+#define TPMS_MIN_TEMP_C    -40
+#define TPMS_MAX_TEMP_C    125
+
+/* Plausible tire pressure in 0.01 bar */
+#define TPMS_MIN_PRESS_cbar  100
+#define TPMS_MAX_PRESS_cbar  450
+
+/* Return values of decode_tpms() */
+#define DECODE_FAILED     0
+#define DECODE_OK         1
+#define DECODE_RECOVERED  2   // Checksum ok after error correction
+
+
+/****************** PROTOCOLS ****************************/
+
+/* Frame encoding */
+#define ENCODING_MANCHESTER  0
+
+/* Checksum type, computed over all bytes before the last one */
+#define CHECKSUM_XOR         0
+#define CHECKSUM_SUM         1   // Sum modulo 256
+#define CHECKSUM_CRC8        2   // Polynomial 0x07, init 0x00
+
+/* Byte order of the sensor ID */
+#define ID_BIG_ENDIAN        0
+#define ID_LITTLE_ENDIAN     1
+
+/* press_hi if the pressure is a single byte */
+#define NO_BYTE              0xff
+
+/* Protocol flags */
+#define PROTO_NO_FLAGS       0x00
+#define PROTO_KNOWN_ONLY     0x01   // Only accept IDs already in the sensor table
+
+/* Max sensor ID length in bytes */
+#define TPMS_ID_LENGTH       4
+
+/*
+ * Protocol descriptor.
+ *
+ * Pressure in 0.01 bar = raw * press_mul / press_div
+ *   raw = (bytes[press_hi] & press_hi_mask) << 8 | bytes[press_lo]
+ * Temperature in C = bytes[temp_byte] - temp_offset
+ */
+typedef struct tpmsProtocol_t {
+  const char *name;       // PROGMEM string
+  uint16_t preamble;
+  byte encoding;
+  byte length;            // Frame length in bytes including checksum
+  byte checksum;
+  byte id_offset;
+  byte id_length;         // 1 .. TPMS_ID_LENGTH
+  byte id_order;
+  byte press_hi;
+  byte press_hi_mask;
+  byte press_lo;
+  uint16_t press_mul;
+  uint16_t press_div;
+  byte temp_byte;
+  byte temp_offset;
+  byte flags;
+} tpmsProtocol_t;
+
+/*
+ * Decoded sensor data.
+ * IDs shorter than TPMS_ID_LENGTH are right aligned, leading bytes are 0.
+ */
+typedef struct tpmsReading_t {
+  byte id[TPMS_ID_LENGTH];
+  byte protocol;          // Index into tpms_protocol[]
+  unsigned int press_cbar;
+  int temp_c;
+} tpmsReading_t;
+
+static const char proto_name_abarth124[] PROGMEM = "abarth124";
+static const char proto_name_renault[] PROGMEM = "renault";
+
+/*
+ * Supported protocols.
+ * They are tried in this order, put the most common one first.
+ * Protocols with the same preamble should follow each other
+ * as they share the decoded data.
+ */
+static const tpmsProtocol_t tpms_protocol[] PROGMEM = {
+
+  /* Abarth 124 / Fiat: ID 4 bytes, pressure 1.38 kPa, temperature +50 */
+  { proto_name_abarth124, 0xAAA9, ENCODING_MANCHESTER, 9, CHECKSUM_XOR,
+    0, 4, ID_BIG_ENDIAN, NO_BYTE, 0x00, 5, 138, 100, 6, 50, PROTO_NO_FLAGS },
+
+  /* Renault: ID 3 bytes little endian, 10 bit pressure 0.75 kPa, temperature +30
+   * Not verified with real sensors. Same preamble and length as abarth124,
+   * so about 1 in 256 corrupted abarth124 frames passes the CRC8.
+   * Only accepted for sensor IDs that are configured or already known.
+   */
+  { proto_name_renault,   0xAAA9, ENCODING_MANCHESTER, 9, CHECKSUM_CRC8,
+    3, 3, ID_LITTLE_ENDIAN, 0, 0x03, 1, 3, 4, 2, 30, PROTO_KNOWN_ONLY }
+};
+
+#define TPMS_NUM_PROTOCOLS  (sizeof(tpms_protocol) / sizeof(tpmsProtocol_t))
+
+/* Number of frames decoded per protocol */
+unsigned int protocol_decoded[TPMS_NUM_PROTOCOLS];
+
 
 /***************** forward defines **********************/
 
-bool decode_tpms( volatile byte timing_array[], unsigned int timing_count, bool start_edge, byteArray_t *data);
+byte decode_tpms( rxFrame_t *frame, tpmsReading_t *reading);
+#ifdef CC1101_PACKET_SUPPORT
+byte decode_tpms_packet( const byte packet[], byte len, tpmsReading_t *reading);
+#endif
+bool decode_frame( rxFrame_t *frame, uint16_t preamble, byteArray_t *data, byteArray_t *invalid);
+void convert_frame( tpmsProtocol_t *proto, byteArray_t *data, tpmsReading_t *reading);
+const __FlashStringHelper *protocol_name( byte protocol);
+byte protocol_flags( byte protocol);
+void dump_protocol_statistics();
+void clear_protocol_statistics();
 
 void clear_bit_array( bitArray_t *bits);
 bool get_bit( bitArray_t *bits, bitLength_t bitno);
@@ -63,68 +183,293 @@ void clear_byte_array( byteArray_t *data);
 byte get_byte( byteArray_t *data, byteLength_t byteno);
 void append_byte( byteArray_t *data, byte value);
 
-byte pulse_type( byte time);
-void bit_decode( volatile byte timing[], unsigned int count, bool start_value, bitArray_t *data);
+byte get_pulse( byte pulses[], byte idx);
+void toggle_pulse( byte pulses[], byte idx);
+void bit_decode( volatile byte pulses[], unsigned int count, bool start_value, bitArray_t *data);
 
-bitLength_t find_preamble( bitArray_t *data, bitArray_t *preamble);
+bitLength_t find_preamble( bitArray_t *data, uint16_t preamble);
 
-void manchester_decode( bitArray_t *bits, bitLength_t start, byteArray_t *data);
+byte get_bits8( bitArray_t *bits, bitLength_t bitno);
+void manchester_decode( bitArray_t *bits, bitLength_t start, byteArray_t *data, byteArray_t *invalid);
 
-bool check_checksum( byteArray_t *data);
+bool check_frame( tpmsProtocol_t *proto, byteArray_t *data);
 byte checksum_xor( byteArray_t *data, byte bytes);
+byte checksum_sum( byteArray_t *data, byte bytes);
+byte checksum_crc8( byteArray_t *data, byte bytes);
+
+bool plausible_frame( tpmsProtocol_t *proto, byteArray_t *data);
+bool recover_frame( rxFrame_t *frame, tpmsProtocol_t *proto, byteArray_t *data, byteArray_t *invalid);
+bool try_pulse_flip( rxFrame_t *frame, tpmsProtocol_t *proto, byte a, byte b, byteArray_t *data);
+
+/********************************************************/
+
+/* Mask of bit 'bitno' within a byte. Bit 0 is the MSB. */
+static const byte bit_mask[8] PROGMEM = {
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+};
+
+/* Manchester decoding of 8 received bits (4 bit pairs) into 4 data bits.
+ * Bit pair 10 decodes to 0, 01 decodes to 1.
+ * Invalid pairs decode to 1 and are flagged in the high nibble.
+ */
+static const byte manchester_table[256] PROGMEM = {
+    0xFF, 0xEF, 0xEE, 0xFF, 0xDF, 0xCF, 0xCE, 0xDF,
+    0xDD, 0xCD, 0xCC, 0xDD, 0xFF, 0xEF, 0xEE, 0xFF,
+    0xBF, 0xAF, 0xAE, 0xBF, 0x9F, 0x8F, 0x8E, 0x9F,
+    0x9D, 0x8D, 0x8C, 0x9D, 0xBF, 0xAF, 0xAE, 0xBF,
+    0xBB, 0xAB, 0xAA, 0xBB, 0x9B, 0x8B, 0x8A, 0x9B,
+    0x99, 0x89, 0x88, 0x99, 0xBB, 0xAB, 0xAA, 0xBB,
+    0xFF, 0xEF, 0xEE, 0xFF, 0xDF, 0xCF, 0xCE, 0xDF,
+    0xDD, 0xCD, 0xCC, 0xDD, 0xFF, 0xEF, 0xEE, 0xFF,
+    0x7F, 0x6F, 0x6E, 0x7F, 0x5F, 0x4F, 0x4E, 0x5F,
+    0x5D, 0x4D, 0x4C, 0x5D, 0x7F, 0x6F, 0x6E, 0x7F,
+    0x3F, 0x2F, 0x2E, 0x3F, 0x1F, 0x0F, 0x0E, 0x1F,
+    0x1D, 0x0D, 0x0C, 0x1D, 0x3F, 0x2F, 0x2E, 0x3F,
+    0x3B, 0x2B, 0x2A, 0x3B, 0x1B, 0x0B, 0x0A, 0x1B,
+    0x19, 0x09, 0x08, 0x19, 0x3B, 0x2B, 0x2A, 0x3B,
+    0x7F, 0x6F, 0x6E, 0x7F, 0x5F, 0x4F, 0x4E, 0x5F,
+    0x5D, 0x4D, 0x4C, 0x5D, 0x7F, 0x6F, 0x6E, 0x7F,
+    0x77, 0x67, 0x66, 0x77, 0x57, 0x47, 0x46, 0x57,
+    0x55, 0x45, 0x44, 0x55, 0x77, 0x67, 0x66, 0x77,
+    0x37, 0x27, 0x26, 0x37, 0x17, 0x07, 0x06, 0x17,
+    0x15, 0x05, 0x04, 0x15, 0x37, 0x27, 0x26, 0x37,
+    0x33, 0x23, 0x22, 0x33, 0x13, 0x03, 0x02, 0x13,
+    0x11, 0x01, 0x00, 0x11, 0x33, 0x23, 0x22, 0x33,
+    0x77, 0x67, 0x66, 0x77, 0x57, 0x47, 0x46, 0x57,
+    0x55, 0x45, 0x44, 0x55, 0x77, 0x67, 0x66, 0x77,
+    0xFF, 0xEF, 0xEE, 0xFF, 0xDF, 0xCF, 0xCE, 0xDF,
+    0xDD, 0xCD, 0xCC, 0xDD, 0xFF, 0xEF, 0xEE, 0xFF,
+    0xBF, 0xAF, 0xAE, 0xBF, 0x9F, 0x8F, 0x8E, 0x9F,
+    0x9D, 0x8D, 0x8C, 0x9D, 0xBF, 0xAF, 0xAE, 0xBF,
+    0xBB, 0xAB, 0xAA, 0xBB, 0x9B, 0x8B, 0x8A, 0x9B,
+    0x99, 0x89, 0x88, 0x99, 0xBB, 0xAB, 0xAA, 0xBB,
+    0xFF, 0xEF, 0xEE, 0xFF, 0xDF, 0xCF, 0xCE, 0xDF,
+    0xDD, 0xCD, 0xCC, 0xDD, 0xFF, 0xEF, 0xEE, 0xFF
+};
 
 /********************************************************/
 
 /*
- * Returns true if decoding was successful.
+ * Try all protocols on a received frame.
+ *
+ * Returns DECODE_OK if decoding was successful,
+ * DECODE_RECOVERED if the checksum was only ok after error correction.
+ * The sensor data is returned in reading.
+ *
+ * Recovered frames are not counted in statistics.checksum_ok.
+ * The caller decides whether to accept them.
  */
-bool decode_tpms( volatile byte timing_array[], unsigned int timing_count, bool start_edge, byteArray_t *data)
+byte decode_tpms( rxFrame_t *frame, tpmsReading_t *reading)
 {
-    bitArray_t preamble;
-    bitArray_t decoded_bits;   // Decoded timing bits
+    tpmsProtocol_t proto;
+    byteArray_t data;
+    byteArray_t invalid;       // Invalid manchester pairs per data bit
+    uint16_t preamble = 0;     // Preamble of the data decoded last
+    bool found = false;        // Preamble of any protocol found
+
+    unsigned long start_usec = micros();
+    unsigned long decode_usec;
+    byte result = DECODE_FAILED;
+    byte p;
+
+    if( frame->count > statistics.max_timings) {
+      statistics.max_timings = frame->count;
+    }
 
-    bitLength_t data_start;    // Data start after preamble
-    
-    byte a_byte;
-    int i;
+    for( p = 0; p < TPMS_NUM_PROTOCOLS; p++) {
+      memcpy_P( &proto, &tpms_protocol[p], sizeof(proto));
 
-    clear_byte_array( data);
-    
-    /* Create a bit array that contains the preamble. 
-     * It is easier to handle.
-     */
-    clear_bit_array( &preamble);
-    preamble.bits[0] = 0xAA;
-    preamble.bits[1] = 0xA9;
-    preamble.length = 16;
-
-    if( timing_count > statistics.max_timings) {
-      statistics.max_timings = timing_count;
+      /* Protocols with the same preamble share the decoded data */
+      if( p == 0 || proto.preamble != preamble) {
+        preamble = proto.preamble;
+        found |= decode_frame( frame, preamble, &data, &invalid);
+      }
+
+      /* decode_frame() sets length 0 if there was no preamble */
+      if( data.length >= proto.length && check_frame( &proto, &data)) {
+        statistics.checksum_ok++;
+        result = DECODE_OK;
+        break;
+      }
     }
 
-    bit_decode( timing_array, timing_count, start_edge, &decoded_bits);
+    if( result == DECODE_FAILED && found) {
+      for( p = 0; p < TPMS_NUM_PROTOCOLS; p++) {
+        memcpy_P( &proto, &tpms_protocol[p], sizeof(proto));
 
-    data_start = find_preamble( &decoded_bits, &preamble);
-   
-    if( data_start > 0) {
-      statistics.preamble_found++;
-       
-      manchester_decode( &decoded_bits, data_start, data);
+        if(    decode_frame( frame, proto.preamble, &data, &invalid)
+            && recover_frame( frame, &proto, &data, &invalid)) {
+          result = DECODE_RECOVERED;
+          break;
+        }
+      }
 
-      if( data->length > 9) {
-        data->length = 9;
+      if( result == DECODE_FAILED) {
+        statistics.checksum_fails++;
       }
+    }
 
-      if( check_checksum( data)) {
-        statistics.checksum_ok++;
-        return true;
+    if( found) {
+      statistics.preamble_found++;
+    }
 
-      } else {
-        statistics.checksum_fails++;
+    if( result != DECODE_FAILED) {
+      protocol_decoded[p]++;
+      reading->protocol = p;
+      convert_frame( &proto, &data, reading);
+    }
+
+    decode_usec = micros() - start_usec;
+    if( decode_usec > statistics.max_decode_usec) {
+      statistics.max_decode_usec = decode_usec;
+    }
+
+    return result;
+}
+
+#ifdef CC1101_PACKET_SUPPORT
+/*
+ * Try the protocols with preamble CC1101_PACKET_SYNC on a packet
+ * received by the CC1101 packet handler.
+ *
+ * The CC1101 already matched the preamble, the packet holds the
+ * Manchester encoded bits following it. There is no error correction,
+ * the weak pulses are not known in packet mode.
+ */
+byte decode_tpms_packet( const byte packet[], byte len, tpmsReading_t *reading)
+{
+    tpmsProtocol_t proto;
+    byteArray_t data;
+    byte hi, lo;
+    byte i, p;
+
+    unsigned long start_usec = micros();
+    unsigned long decode_usec;
+    byte result = DECODE_FAILED;
+
+    clear_byte_array( &data);
+
+    for( i = 0; i + 1 < len; i += 2) {
+        hi = pgm_read_byte( &manchester_table[ packet[i]]);
+        lo = pgm_read_byte( &manchester_table[ packet[i + 1]]);
+
+        append_byte( &data, (MANCHESTER_BITS(hi) << 4) | MANCHESTER_BITS(lo));
+    }
+
+    for( p = 0; p < TPMS_NUM_PROTOCOLS; p++) {
+      memcpy_P( &proto, &tpms_protocol[p], sizeof(proto));
+
+      if( proto.preamble == CC1101_PACKET_SYNC && check_frame( &proto, &data)) {
+        result = DECODE_OK;
+        break;
       }
     }
 
-    return false;
+    if( result == DECODE_OK) {
+      /* The CC1101 matched the sync word on every packet,
+       * only packets that decode count as preamble found.
+       */
+      statistics.preamble_found++;
+      statistics.checksum_ok++;
+      protocol_decoded[p]++;
+      reading->protocol = p;
+      convert_frame( &proto, &data, reading);
+    } else {
+      statistics.checksum_fails++;
+    }
+
+    decode_usec = micros() - start_usec;
+    if( decode_usec > statistics.max_decode_usec) {
+      statistics.max_decode_usec = decode_usec;
+    }
+
+    return result;
+}
+#endif
+
+/*
+ * Decode pulses to data bytes.
+ * Returns false if there was no preamble.
+ */
+bool decode_frame( rxFrame_t *frame, uint16_t preamble, byteArray_t *data, byteArray_t *invalid)
+{
+    bitArray_t decoded_bits;   // Decoded timing bits
+
+    bitLength_t data_start;    // Data start after preamble
+
+    bit_decode( frame->pulses, frame->count, frame->first_edge_state, &decoded_bits);
+
+    data_start = find_preamble( &decoded_bits, preamble);
+
+    if( data_start == 0) {
+      clear_byte_array( data);
+      return false;
+    }
+
+    /* ENCODING_MANCHESTER is the only encoding so far */
+    manchester_decode( &decoded_bits, data_start, data, invalid);
+
+    return true;
+}
+
+/*
+ * Extract sensor ID, pressure and temperature.
+ */
+void convert_frame( tpmsProtocol_t *proto, byteArray_t *data, tpmsReading_t *reading)
+{
+    unsigned long press_raw;
+    byte i;
+
+    memset( reading->id, 0, TPMS_ID_LENGTH);
+
+    for( i = 0; i < proto->id_length; i++) {
+      reading->id[ TPMS_ID_LENGTH - proto->id_length + i] =
+        get_byte( data, proto->id_offset + ((proto->id_order == ID_BIG_ENDIAN) ? i : proto->id_length - 1 - i));
+    }
+
+    press_raw = get_byte( data, proto->press_lo);
+    if( proto->press_hi != NO_BYTE) {
+      press_raw |= (unsigned long)(get_byte( data, proto->press_hi) & proto->press_hi_mask) << 8;
+    }
+
+    reading->press_cbar = press_raw * proto->press_mul / proto->press_div;
+    reading->temp_c = (int)get_byte( data, proto->temp_byte) - proto->temp_offset;
+}
+
+/*
+ * Name of a protocol, e.g. for Serial.print()
+ */
+const __FlashStringHelper *protocol_name( byte protocol)
+{
+    return (const __FlashStringHelper *)pgm_read_word( &tpms_protocol[protocol].name);
+}
+
+/*
+ * PROTO_* flags of a protocol.
+ */
+byte protocol_flags( byte protocol)
+{
+    return pgm_read_byte( &tpms_protocol[protocol].flags);
+}
+
+/* Send number of decoded frames per protocol.
+ * Called by the I command.
+ */
+void dump_protocol_statistics()
+{
+  for( byte p = 0; p < TPMS_NUM_PROTOCOLS; p++) {
+    Serial.print(F("+proto "));
+    Serial.print(protocol_name( p));
+    Serial.print(F(" = "));
+    Serial.println(protocol_decoded[p]);
+  }
+}
+
+/* Called by clear_statistics().
+ */
+void clear_protocol_statistics()
+{
+  memset( protocol_decoded, 0, sizeof(protocol_decoded));
 }
 
 /********************************************************/
@@ -147,7 +492,7 @@ void clear_bit_array( bitArray_t *bits)
 bool get_bit( bitArray_t *bits, bitLength_t bitno)
 {
     if( bitno < bits->capacity) {
-        return (bits->bits[bitno/8] & (1 << (7-(bitno % 8)))) ? true : false;
+        return (bits->bits[bitno >> 3] & pgm_read_byte( &bit_mask[bitno & 7])) ? true : false;
     } else {
 
 #ifdef SHOWDEBUGINFO
@@ -165,10 +510,12 @@ bool get_bit( bitArray_t *bits, bitLength_t bitno)
 void set_bit( bitArray_t *bits, bitLength_t bitno, bool value)
 {
     if( bitno < bits->capacity) {
+        byte mask = pgm_read_byte( &bit_mask[bitno & 7]);
+
         if( value) {
-            bits->bits[bitno/8] |= (byte)(1 << (7-(bitno % 8)));
+            bits->bits[bitno >> 3] |= mask;
         } else {
-            bits->bits[bitno/8] &= ~((byte)(1 << (7-(bitno % 8))));
+            bits->bits[bitno >> 3] &= ~mask;
         }
         if( bitno >= bits->length) {
             bits->length = bitno +1;
@@ -187,6 +534,22 @@ void append_bit( bitArray_t *bits, bool value)
   set_bit( bits, bits->length, value);
 }
 
+/*
+ * Returns 8 bits starting at bitno. Bitno does not need to be byte aligned.
+ * Bits beyond length read as 0 as the bit array has been cleared before.
+ */
+byte get_bits8( bitArray_t *bits, bitLength_t bitno)
+{
+    byte idx = bitno >> 3;
+    byte shift = bitno & 7;
+
+    if( shift == 0) {
+        return bits->bits[idx];
+    }
+
+    return (bits->bits[idx] << shift) | (bits->bits[idx+1] >> (8 - shift));
+}
+
 /********************************************************/
 
 void clear_byte_array( byteArray_t *data)
@@ -238,45 +601,51 @@ void append_byte( byteArray_t *data, byte value)
 
 /********************************************************/
 
-byte pulse_type( byte time_usec)
+/*
+ * Pulse code at idx in the packed pulse buffer.
+ */
+byte get_pulse( byte pulses[], byte idx)
 {
-    if( time_usec < MIN_SHORT_usec) {
-        return INVALID_PULSE;
-    }
-
-    if( time_usec < MIN_LONG_usec) {
-        return SHORT_PULSE;
-    }
+    return (pulses[idx / PULSES_PER_BYTE] >> ((idx & (PULSES_PER_BYTE - 1)) * PULSE_BITS)) & PULSE_MASK;
+}
 
-    return LONG_PULSE;
+/*
+ * Turn SHORT_PULSE into LONG_PULSE and vice versa.
+ */
+void toggle_pulse( byte pulses[], byte idx)
+{
+    pulses[idx / PULSES_PER_BYTE] ^= (SHORT_PULSE ^ LONG_PULSE) << ((idx & (PULSES_PER_BYTE - 1)) * PULSE_BITS);
 }
 
 /********************************************************/
 
-/* Konvertiert timings zu bits.
+/* Konvertiert pulse codes zu bits.
  *
  * Parameter:
- *   const byte timing[]    - Timing array
- *   int count              - Anzahl der bytes in timing array
+ *   volatile byte pulses[] - Gepackte pulse codes, 4 pro byte
+ *   int count              - Anzahl der pulse codes
+ *   start_value            - Pegel der ersten Flanke
  *   data                   - Rückgabe der Bit Werte
  *
  * Return:
  *   nix
  */
-void bit_decode( volatile byte timing[], unsigned int count, bool start_value,  bitArray_t *bits)
+void bit_decode( volatile byte pulses[], unsigned int count, bool start_value,  bitArray_t *bits)
 {
-    unsigned int timing_idx = 0;
-    unsigned int timing_len_usec = 0;
+    unsigned int pulse_idx;
+    byte packed = 0;
     bitLength_t bit_count = 0;
     bool level = start_value;
 
     clear_bit_array( bits);
 
-    for( timing_idx = 0; timing_idx < count; timing_idx++) {
-        
-        timing_len_usec += timing[timing_idx];
-        
-        switch( pulse_type( timing[timing_idx] ) ) {
+    for( pulse_idx = 0; pulse_idx < count; pulse_idx++) {
+
+        if( (pulse_idx & (PULSES_PER_BYTE - 1)) == 0) {
+            packed = pulses[pulse_idx / PULSES_PER_BYTE];
+        }
+
+        switch( packed & PULSE_MASK) {
         case LONG_PULSE: /* 2 pulses */
             set_bit( bits, bit_count++, level);
             /* Fall through */
@@ -286,6 +655,7 @@ void bit_decode( volatile byte timing[], unsigned int count, bool start_value,
             break;
         }
 
+        packed >>= PULSE_BITS;
         level = !level;
     }
 }
@@ -295,97 +665,102 @@ void bit_decode( volatile byte timing[], unsigned int count, bool start_value,
 /* Findet die Präambel im bit array.
  * Gibt den index des ersten bits nach der Präambel zurück.
  *
+ * Die bits werden byteweise geladen und durch ein 16 bit Schieberegister
+ * geschoben, das nach jedem bit mit der Präambel verglichen wird.
+ * Dadurch entfällt das Zurücksetzen bei einem Fehlvergleich.
+ *
  * Parameter:
  *
  * Return: > 0    - Start Index nach der Präambel
  *         0      - Keine Präambel gefunden
  */
-bitLength_t find_preamble( bitArray_t *bits, bitArray_t *preamble)
+bitLength_t find_preamble( bitArray_t *bits, uint16_t preamble)
 {
     bitLength_t bit_idx = 0;
-    bitLength_t pre_idx = 0;
-    bitLength_t saved_start = 0;
-    bitLength_t data_start = 0;
+    bitLength_t limit;
+    uint16_t shift_reg = 0;
+    byte a_byte = 0;
 
-    if( bits->length <= preamble->length) {
+    if( bits->length <= 16) {
       /* Not enough bits to detect preamble - bail out.*/
       return 0;
     }
 
-    while( bit_idx < (bits->length - preamble->length)) {
+    /* At least 16 data bits have to follow the preamble */
+    limit = bits->length - 16;
+
+    while( bit_idx < limit) {
 
-        if( pre_idx == 0) { /* Remember start for restart on match failure */
-            saved_start = bit_idx;
+        if( (bit_idx & 7) == 0) { /* Load next byte */
+            a_byte = bits->bits[bit_idx >> 3];
         }
-        
-        if( get_bit( bits, bit_idx) == get_bit( preamble, pre_idx) ) { 
-            /* Match, advance preamble and bit index */
-            pre_idx++;
-            bit_idx++;
-            
-            if( pre_idx >= preamble->length) { /* All preamble bits found, done */
-                data_start = bit_idx;
-                break;
-            }
-        } else { /* fail, restart with next bit */
-            pre_idx = 0;
-            bit_idx = saved_start + 1;
+
+        shift_reg = (shift_reg << 1) | (a_byte >> 7);
+        a_byte <<= 1;
+        bit_idx++;
+
+        if( shift_reg == preamble && bit_idx >= 16) {
+            return bit_idx;
         }
     }
 
-    return data_start;
+    return 0;
 }
 
 /********************************************************/
 
-/* Manchester decode geht am einfachsten über ein XOR verknüpfung
- * mit dem Clock Signal  ( 1010101010101.... )
+/* Manchester decode über eine Tabelle.
+ * Je 8 empfangene bits (4 bit Paare) ergeben ein nibble.
+ *
+ * In 'invalid' wird pro data bit markiert, ob das bit Paar ungültig war.
  */
-void manchester_decode( bitArray_t *bits, bitLength_t start, byteArray_t *data)
+void manchester_decode( bitArray_t *bits, bitLength_t start, byteArray_t *data, byteArray_t *invalid)
 {
-    bitLength_t bit_idx;
-    bitLength_t bit_count = 0;
-
-    unsigned int an_int = 0;
-    byte a_byte = 0;
-    byte n;
+    unsigned int bit_idx;
+    byte hi, lo;
 
     clear_byte_array( data);
+    clear_byte_array( invalid);
     
-    for( bit_idx = start; bit_idx < bits->length; bit_idx++) {
-
-        an_int <<= 1;
-        an_int |= get_bit( bits, bit_idx) ? 1 : 0;
-        bit_count++;
-
-        if( bit_count == 16) { /* Decode 16 bits via XOR with clock signal to one byte */
-            an_int ^= MANCHESTER_DECODING_MASK;
-            a_byte = 0;
-            
-            for( n = 0; n < 8; n++) { /* Convert 16 bits to one byte */
-                a_byte <<= 1;
-                a_byte |= ((an_int & 0xc000) ? 1 : 0);
-                an_int <<= 2;
-            }
-            
-            append_byte( data, a_byte);
-            bit_count = 0;
-            an_int = 0;
-        }
+    for( bit_idx = start; bit_idx + 16 <= bits->length; bit_idx += 16) {
+
+        hi = pgm_read_byte( &manchester_table[ get_bits8( bits, bit_idx)]);
+        lo = pgm_read_byte( &manchester_table[ get_bits8( bits, bit_idx + 8)]);
+
+        append_byte( data, (MANCHESTER_BITS(hi) << 4) | MANCHESTER_BITS(lo));
+        append_byte( invalid, MANCHESTER_INVALID(hi) | (MANCHESTER_INVALID(lo) >> 4));
     }
 }
 
 /* 
- *  Check XOR checksum.
- *  Compute XOR value of first 8 bytes, than compare with 9th byte.
+ *  Check length and checksum of a frame.
+ *  The checksum is the last byte of the frame.
  *  
  *  Returns true if checksum is ok.
  */
-bool check_checksum( byteArray_t *data)
+bool check_frame( tpmsProtocol_t *proto, byteArray_t *data)
 {
-  byte csum = checksum_xor( data, 8);
+  byte count = proto->length - 1;
+  byte csum;
+
+  if( data->length < proto->length) {
+    return false;
+  }
 
-  return csum == get_byte( data, 8);
+  switch( proto->checksum) {
+  case CHECKSUM_SUM:
+    csum = checksum_sum( data, count);
+    break;
+
+  case CHECKSUM_CRC8:
+    csum = checksum_crc8( data, count);
+    break;
+
+  default:
+    csum = checksum_xor( data, count);
+  }
+
+  return csum == get_byte( data, count);
 }
 
 /*
@@ -403,3 +778,152 @@ byte checksum_xor( byteArray_t *data, byte count)
 
   return checksum;
 }
+
+/*
+ * Compute sum modulo 256 of first 'count' bytes in data.
+ */
+byte checksum_sum( byteArray_t *data, byte count)
+{
+  byteLength_t i;
+  byte checksum;
+
+  checksum = 0;
+  for( i = 0; i < count; i++) {
+    checksum += get_byte( data, i);
+  }
+
+  return checksum;
+}
+
+/*
+ * Compute CRC-8 (polynomial 0x07, init 0x00) of first 'count' bytes in data.
+ */
+byte checksum_crc8( byteArray_t *data, byte count)
+{
+  byteLength_t i;
+  byte n;
+  byte crc;
+
+  crc = 0;
+  for( i = 0; i < count; i++) {
+    crc ^= get_byte( data, i);
+    for( n = 0; n < 8; n++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+/********************************************************/
+
+/*
+ * Checksum ok and values within sensible limits.
+ */
+bool plausible_frame( tpmsProtocol_t *proto, byteArray_t *data)
+{
+  tpmsReading_t reading;
+
+  if( !check_frame( proto, data)) {
+    return false;
+  }
+
+  convert_frame( proto, data, &reading);
+
+  return    reading.temp_c >= TPMS_MIN_TEMP_C
+         && reading.temp_c <= TPMS_MAX_TEMP_C
+         && reading.press_cbar >= TPMS_MIN_PRESS_cbar
+         && reading.press_cbar <= TPMS_MAX_PRESS_cbar;
+}
+
+/*
+ * Try to correct a frame that failed the checksum.
+ *
+ * 1. XOR checksum only: If the XOR of all bytes has a single bit set,
+ *    flip that bit in a byte where it was decoded from an invalid
+ *    manchester pair.
+ * 2. Toggle weak pulses (closest to the SHORT/LONG boundary first),
+ *    alone or swapped with a neighbour pulse, and decode again.
+ *
+ * Returns true and the corrected frame in data on success.
+ */
+bool recover_frame( rxFrame_t *frame, tpmsProtocol_t *proto, byteArray_t *data, byteArray_t *invalid)
+{
+  byte weak[CC1101_WEAK_PULSES];
+  byte dist[CC1101_WEAK_PULSES];
+  byte syndrome;
+  byte i, j;
+  byte idx;
+
+  /* 1. Single bit flip */
+  if( proto->checksum == CHECKSUM_XOR && data->length >= proto->length) {
+    syndrome = checksum_xor( data, proto->length);
+
+    if( (syndrome & (syndrome - 1)) == 0) { /* Exactly one bit set */
+      for( i = 0; i < proto->length; i++) {
+        if( invalid->bytes[i] & syndrome) {
+          data->bytes[i] ^= syndrome;
+          if( plausible_frame( proto, data)) {
+            return true;
+          }
+          data->bytes[i] ^= syndrome;
+        }
+      }
+    }
+  }
+
+  /* 2. Pulse flips, sort weak pulses by distance first */
+  for( i = 0; i < frame->weak_count; i++) {
+    for( j = i; j > 0 && dist[j-1] > frame->weak_dist[i]; j--) {
+      weak[j] = weak[j-1];
+      dist[j] = dist[j-1];
+    }
+    weak[j] = frame->weak_idx[i];
+    dist[j] = frame->weak_dist[i];
+  }
+
+  for( i = 0; i < frame->weak_count; i++) {
+    idx = weak[i];
+
+    if( try_pulse_flip( frame, proto, idx, idx, data)) {
+      return true;
+    }
+    if( idx + 1 < frame->count && try_pulse_flip( frame, proto, idx, idx + 1, data)) {
+      return true;
+    }
+    if( idx > 0 && try_pulse_flip( frame, proto, idx - 1, idx, data)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * Toggle pulse a (and b if different), decode and check.
+ * The pulse buffer is restored afterwards.
+ */
+bool try_pulse_flip( rxFrame_t *frame, tpmsProtocol_t *proto, byte a, byte b, byteArray_t *data)
+{
+  byteArray_t invalid;
+  bool ok;
+
+  if( a != b && get_pulse( frame->pulses, a) == get_pulse( frame->pulses, b)) {
+    /* Only a SHORT/LONG swap keeps the frame length */
+    return false;
+  }
+
+  toggle_pulse( frame->pulses, a);
+  if( a != b) {
+    toggle_pulse( frame->pulses, b);
+  }
+
+  ok = decode_frame( frame, proto->preamble, data, &invalid) && plausible_frame( proto, data);
+
+  toggle_pulse( frame->pulses, a);
+  if( a != b) {
+    toggle_pulse( frame->pulses, b);
+  }
+
+  return ok;
+}
@@ -14,6 +14,7 @@
 #include "oil_sensor.h"
 #include "rgb_analog.h"
 #include "ws2801.h"
+#include "led_effects.h"
 
 String versionInfo = "0.3.0";
 
@@ -131,18 +132,21 @@ void setup() {
   addAction( &tpmsReceiver);
 #endif
 #ifdef OIL_SUPPORT
-  addAction( new OilSensor);
+  addAction( &oilSensor);
 #endif
 #ifdef RGB_SUPPORT
-  addAction( new RgbAnalog);
+  addAction( &rgbLed);
 #endif
 #ifdef WS2801_SUPPORT
-  addAction( new WS2801);
+  addAction( &ledStrip);
 #endif
 
   #ifdef DISPLAY_SUPPORT
   addAction( new Display);
 #endif
+#ifdef LED_EFFECTS_SUPPORT
+  addAction( &ledEffects);
+#endif
 
   setupActions();
 
@@ -381,6 +385,13 @@ static void infoCommand()
   sendMoreDataEnd();
 
   dump_statistics();
+
+#ifdef CC1101_SUPPORT
+  dump_pulse_statistics();
+#endif
+#ifdef TPMS_433_SUPPORT
+  dump_protocol_statistics();
+#endif
       
 #ifdef ENABLE_MEMDEBUG     
   MEMDEBUG_CHECK();
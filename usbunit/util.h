@@ -45,15 +45,38 @@ typedef struct statistics_t {
   unsigned long data_interrupts;
   unsigned long carrier_detected;
   unsigned long data_available;
+  unsigned long edges_avoided;      // edge ISR calls avoided, lower bound
   unsigned int carrier_len;
   unsigned int max_timings;
   unsigned int bit_errors;
   unsigned int preamble_found;
   unsigned int checksum_ok;
   unsigned int checksum_fails;
+  unsigned int checksum_recovered;
+  unsigned long duplicates;
+  unsigned int max_decode_usec;
+  unsigned int display_bytes;       // I2C bytes of the last display refresh
+  unsigned int display_bytes_max;
+  unsigned int display_stall_usec;  // longest display step in loop()
+  unsigned int display_render_usec; // last update_display() step
+  unsigned int display_render_max;
+  unsigned int display_errors;      // I2C transactions not acknowledged
 } statistics_t;
 
 static volatile statistics_t statistics;
+static unsigned long statistics_start = 0;   // millis() of last clear
+
+/* Rate of a counter since the last clear_statistics().
+ */
+unsigned int per_minute( unsigned long count)
+{
+  unsigned long elapsed = millis() - statistics_start;
+
+  if( elapsed < 1000) {
+    return 0;
+  }
+  return count * 60000.0 / elapsed;
+}
 
 /* Note: dump happens unlatched. 
  * Wrong data may be printed (sometimes).
@@ -80,9 +103,37 @@ void dump_statistics()
   Serial.println(statistics.checksum_ok);
   Serial.print(F("+cksum fails = "));
   Serial.println(statistics.checksum_fails);
+  Serial.print(F("+cksum recov = "));
+  Serial.println(statistics.checksum_recovered);
+  Serial.print(F("+dup/min     = "));
+  Serial.print(per_minute( statistics.duplicates));
+  Serial.print(F(" total "));
+  Serial.println(statistics.duplicates);
+  Serial.print(F("+decode us   = "));
+  Serial.println(statistics.max_decode_usec);
+  Serial.print(F("+disp bytes  = "));
+  Serial.print(statistics.display_bytes);
+  Serial.print(F(" max "));
+  Serial.println(statistics.display_bytes_max);
+  Serial.print(F("+disp render = "));
+  Serial.print(statistics.display_render_usec);
+  Serial.print(F(" max "));
+  Serial.println(statistics.display_render_max);
+  Serial.print(F("+disp stall  = "));
+  Serial.println(statistics.display_stall_usec);
+  Serial.print(F("+disp errors = "));
+  Serial.println(statistics.display_errors);
 }
 
+#ifdef TPMS_433_SUPPORT
+void clear_protocol_statistics();    // tpms_decode.h
+#endif
+
 void clear_statistics()
 {
   memset( (void*)&statistics, 0, sizeof(statistics));
+#ifdef TPMS_433_SUPPORT
+  clear_protocol_statistics();
+#endif
+  statistics_start = millis();
 }
@@ -7,6 +7,15 @@
 
 #ifdef WS2801_SUPPORT
 
+#if defined(WS2801_HW_SPI) && defined(CC1101_SUPPORT)
+ #error "WS2801_HW_SPI: the CC1101 traffic on the SPI bus would be clocked into the strip"
+#endif
+
+/* The WS2801 latches the data once the clock is low for 500 usec.
+ * A new frame is only sent after this time, see WS2801::show().
+ */
+#define WS2801_LATCH_usec   600
+
 typedef struct ws2801_config_t {
   byte ledCount;
 
@@ -19,9 +28,9 @@ class WS2801 : public Action {
   private:
     unsigned int configLocation;
     ws2801_config_t ws2801Config;
-    byte red;
-    byte green;
-    byte blue;
+    byte *pixels = NULL;            // R, G, B per LED
+    bool dirty = false;             // pixels changed, not sent yet
+    unsigned long last_show = 0;    // micros() of the last frame
 
   public:
     size_t setup(unsigned int eepromLocation);
@@ -32,9 +41,15 @@ class WS2801 : public Action {
     void sendConfig();
     void setConfig();
 
+    byte getCount();
+    void setPixel( byte led, byte r, byte g, byte b);
+    void show();
+
   private:
-    void setWS2801( byte r, byte g, byte b);
+    void allocPixels();
     void serialByteOut( byte b);
 };
 
+WS2801 ledStrip;
+
 #endif
@@ -9,21 +9,49 @@
  * Query data: No
  *   
  * Query config: Yes
- *   send intensity per color
- *     Keys: R, G, B
  *   send number of LEDs of the strip
  *     Key: LEDS
+ *   send intensity per color and LED
+ *     Line: <led> R=<r> G=<g> B=<b>
  *   
  * Set config: Yes
- *   set intensity per color
- *     Keys: R, G, B
  *   set number of LEDs of the strip
  *     Key: LEDS
+ *   set intensity per color
+ *     Keys: R, G, B
+ *   select the LEDs, default all
+ *     Keys: L (first LED), N (number of LEDs, default 1 if L is given)
  * 
  */
 
 #ifdef WS2801_SUPPORT
 
+#ifdef WS2801_HW_SPI
+
+#include <SPI.h>
+
+#else
+
+/* Direct pin access, digitalWrite() is too slow */
+#ifdef REDBEAR_DUO
+ #define WS2801_CLOCK_LOW()   pinResetFast( WS2801_CLOCK_PIN)
+ #define WS2801_CLOCK_HIGH()  pinSetFast( WS2801_CLOCK_PIN)
+ #define WS2801_DATA_LOW()    pinResetFast( WS2801_DATA_PIN)
+ #define WS2801_DATA_HIGH()   pinSetFast( WS2801_DATA_PIN)
+#else
+static volatile uint8_t *ws2801_clock_port;
+static volatile uint8_t *ws2801_data_port;
+static uint8_t ws2801_clock_mask;
+static uint8_t ws2801_data_mask;
+
+ #define WS2801_CLOCK_LOW()   (*ws2801_clock_port &= ~ws2801_clock_mask)
+ #define WS2801_CLOCK_HIGH()  (*ws2801_clock_port |= ws2801_clock_mask)
+ #define WS2801_DATA_LOW()    (*ws2801_data_port &= ~ws2801_data_mask)
+ #define WS2801_DATA_HIGH()   (*ws2801_data_port |= ws2801_data_mask)
+#endif
+
+#endif
+
 size_t WS2801::setup(unsigned int eepromLocation)
 {
   size_t sizeOfConfig = sizeof(ws2801Config);
@@ -41,20 +69,39 @@ size_t WS2801::setup(unsigned int eepromLocation)
     EEPROM.put( eepromLocation, ws2801Config);
   }
 
+#ifdef WS2801_HW_SPI
+  /* Data on MOSI, clock on SCK. The clock idles low in mode 0. */
+  SPI.begin();
+  SPI.setBitOrder( MSBFIRST);
+  SPI.setDataMode( SPI_MODE0);
+  SPI.setClockDivider( SPI_CLOCK_DIV16);
+#else
   pinMode(WS2801_CLOCK_PIN, OUTPUT);
   pinMode(WS2801_DATA_PIN, OUTPUT);
 
-  digitalWrite(WS2801_CLOCK_PIN, HIGH);
+  digitalWrite(WS2801_CLOCK_PIN, LOW);
   digitalWrite(WS2801_DATA_PIN, LOW);
 
-  setWS2801( 0, 0, 0);
+#ifndef REDBEAR_DUO
+  ws2801_clock_port = portOutputRegister( digitalPinToPort( WS2801_CLOCK_PIN));
+  ws2801_clock_mask = digitalPinToBitMask( WS2801_CLOCK_PIN);
+  ws2801_data_port = portOutputRegister( digitalPinToPort( WS2801_DATA_PIN));
+  ws2801_data_mask = digitalPinToBitMask( WS2801_DATA_PIN);
+#endif
+#endif
+
+  allocPixels();
+  show();
 
   return (size_t)sizeOfConfig;
 }
 
+/* Send a frame that could not be sent within the latch time */
 void WS2801::timeout()
 {
-  /* nothing */  
+  if( dirty) {
+    show();
+  }
 }
 
 const char *WS2801::getName()
@@ -75,57 +122,129 @@ void WS2801::sendData()
 void WS2801::sendConfig()
 {
   sendMoreData( "LEDS="+String(ws2801Config.ledCount));
-  sendMoreData( "R="+String(red));
-  sendMoreData( "G="+String(green));
-  sendMoreData( "B="+String(blue));
+
+  for( byte i = 0; i < ws2801Config.ledCount; i++) {
+    sendMoreData( String(i)
+                  + " R=" + String(pixels[3 * i])
+                  + " G=" + String(pixels[3 * i + 1])
+                  + " B=" + String(pixels[3 * i + 2]));
+  }
 }
 
 void WS2801::setConfig()
 {
   byte leds = getIntParam("LEDS", 0);
+  int first;
+  int count;
+  byte r, g, b;
 
-  if( leds > 0) {
+  if( leds > 0 && leds != ws2801Config.ledCount) {
     ws2801Config.ledCount = leds;
 
     ws2801Config.checksum = computeChecksum( &ws2801Config, sizeof(ws2801Config));
     EEPROM.put( configLocation, ws2801Config);
+
+    allocPixels();
   }
-  
-  setWS2801( getIntParam("R", 0), getIntParam("G", 0), getIntParam("B", 0));
-}
 
+  first = getIntParam("L", -1);
+  count = getIntParam("N", first < 0 ? ws2801Config.ledCount : 1);
 
-/* ***************** PRIVATE *************************************************/
+  if( first < 0) {
+    first = 0;
+  }
+  if( first >= ws2801Config.ledCount || count < 0) {
+    flagError( ERROR_INVALID_PARAM);
+    return;
+  }
+  if( count > ws2801Config.ledCount - first) {
+    count = ws2801Config.ledCount - first;
+  }
 
+  r = getIntParam("R", 0);
+  g = getIntParam("G", 0);
+  b = getIntParam("B", 0);
 
-void WS2801::setWS2801( byte r, byte g, byte b)
+  for( int i = first; i < first + count; i++) {
+    setPixel( i, r, g, b);
+  }
+  show();
+}
+
+byte WS2801::getCount()
 {
-  red = r;
-  green = g;
-  blue = b;
+  return ws2801Config.ledCount;
+}
 
-  digitalWrite( WS2801_CLOCK_PIN, LOW);
-  delayMicroseconds(1000); /* WS2801 requires at least 500usec. */
+void WS2801::setPixel( byte led, byte r, byte g, byte b)
+{
+  if( led < ws2801Config.ledCount) {
+    pixels[3 * led]     = r;
+    pixels[3 * led + 1] = g;
+    pixels[3 * led + 2] = b;
+    dirty = true;
+  }
+}
+
+/*
+ * Send the framebuffer to the strip.
+ * Postponed to timeout() if the last frame is not latched yet.
+ */
+void WS2801::show()
+{
+  unsigned int n = 3 * ws2801Config.ledCount;
+
+  if( micros() - last_show < WS2801_LATCH_usec) {
+    dirty = true;
+    return;
+  }
 
-  for( int i=0; i<ws2801Config.ledCount; i++) {
-    serialByteOut( r);
-    serialByteOut( g);
-    serialByteOut( b);
+  for( unsigned int i = 0; i < n; i++) {
+    serialByteOut( pixels[i]);
   }
+
+#ifndef WS2801_HW_SPI
+  WS2801_CLOCK_LOW();
+#endif
+
+  last_show = micros();
+  dirty = false;
+}
+
+
+/* ***************** PRIVATE *************************************************/
+
+
+/* (Re)allocate the framebuffer for ws2801Config.ledCount LEDs, all off */
+void WS2801::allocPixels()
+{
+  pixels = (byte*)realloc( pixels, 3 * ws2801Config.ledCount);
+  if( pixels == NULL) {
+    ws2801Config.ledCount = 0;
+    return;
+  }
+  memset( pixels, 0, 3 * ws2801Config.ledCount);
+  dirty = true;
 }
 
-/* Output one byte using DATA_BIT and CLOCK_BIT.
+/* Output one byte, MSB first.
  */
 void WS2801::serialByteOut( byte b) 
 {
-  for( int bn = 7; bn >= 0; bn--)
+#ifdef WS2801_HW_SPI
+  SPI.transfer( b);
+#else
+  for( byte mask = 0x80; mask != 0; mask >>= 1)
   {
-    digitalWrite( WS2801_CLOCK_PIN, LOW);
-    digitalWrite( WS2801_DATA_PIN, (b & bit(bn)) ? HIGH : LOW);
-    delayMicroseconds( 10);
-    digitalWrite( WS2801_CLOCK_PIN, HIGH);
-    delayMicroseconds( 10);
+    WS2801_CLOCK_LOW();
+    if( b & mask) {
+      WS2801_DATA_HIGH();
+    } else {
+      WS2801_DATA_LOW();
+    }
+    WS2801_CLOCK_HIGH();
   }
+#endif
 }
 
 #endif